@@ -0,0 +1,127 @@
+// include/AdaptiveGrid.h
+#ifndef ADAPTIVE_GRID_H
+#define ADAPTIVE_GRID_H
+
+#include <vector>
+#include <cstdint>
+#include "BodyRegistry.h"
+
+struct HeightField;
+
+// the deformation grid as a quadtree of square cells that splits where the
+// potential bends most, around the bodies, and stays coarse in the flat far field.
+// neighbouring cells differ by at most one level (2:1 balance), and a coarse cell's
+// edge is drawn through the vertex its finer neighbours put on it, so the lines
+// never crack. only the cells near bodies that moved are refitted, and only the
+// leaves that refit or balance added or removed, plus their neighbours, have their
+// vertices and lines re-emitted. a moved body still shifts the far field under
+// every vertex, so every target takes that body's change in pull
+class AdaptiveGrid
+{
+public:
+    // a square of side extent centred on the origin; cells range from
+    // extent / 2^minDepth down to extent / 2^maxDepth (maxDepth at most 15)
+    AdaptiveGrid(float extent, unsigned int minDepth, unsigned int maxDepth);
+
+    // a cell splits while the height error of drawing it flat,
+    // scale * size^2 / 8 * curvature, would exceed this
+    float Tolerance;
+
+    // refits the tree to the bodies that moved and re-targets the vertices to
+    // scale * the Plummer potential, plus layer sampled under each vertex when
+    // given (re-read every call, the tree does not refine for it). true when the
+    // vertex or line lists changed (not only the heights)
+    bool Update(const BodyRegistry& bodies, float softening, float scale, const HeightField* layer = nullptr);
+    // eases the drawn heights toward the targets; false once settled
+    bool Ease(float factor);
+
+    // xyz per vertex, y the eased height, and the GL_LINES index pairs. a vertex
+    // keeps its slot while it is drawn; the slots of vertices that went away stay
+    // in the list, unreferenced, until a new vertex takes them
+    const std::vector<float>& Vertices() const { return this->vertices; }
+    const std::vector<unsigned int>& Lines() const { return this->lines; }
+    unsigned int VertexCount() const { return (unsigned int)(this->keys.size() - this->freeSlots.size()); }
+    unsigned int LeafCount() const { return this->leafCount; }
+
+private:
+    struct Node
+    {
+        uint16_t Col, Row;   // lower corner, in finest cells
+        uint8_t Depth;
+        int32_t Children;    // first of four consecutive nodes, -1 for a leaf, -2 when free
+    };
+    // where a moved body can change the tree: its old and new spots, and per depth
+    // how far from them it can still split a cell, from the larger of its two parameters
+    struct Reach
+    {
+        float MinX, MinZ, MaxX, MaxZ;
+        float Radius[16];
+    };
+
+    float extent;
+    unsigned int minDepth, maxDepth;
+    unsigned int resolution;   // finest cells per side
+    float softening, scale;
+
+    std::vector<Node> nodes;
+    std::vector<int32_t> freeBlocks;
+    unsigned int leafCount;
+
+    const BodyRegistry* fitted;
+    uint64_t fittedVersion;
+    std::vector<float> appliedX, appliedZ, appliedGM;
+
+    // per finest-lattice vertex: its slot in vertices (UINT32_MAX when absent), how
+    // many leaves have it as a corner, the bodies' height there and its eased and
+    // target heights, kept so vertices that appear start from what was drawn there
+    std::vector<uint32_t> slots;
+    std::vector<uint8_t> corners;
+    std::vector<float> potential, shown, target;
+    std::vector<uint8_t> depthMap;   // leaf depth per finest cell
+
+    std::vector<uint32_t> keys;      // lattice index of each slot, UINT32_MAX when free
+    std::vector<uint32_t> freeSlots;
+    std::vector<float> vertices;
+    std::vector<float> pointX, pointZ, pointHeights;   // per slot
+    // the GL_LINES pairs, each tagged with its leaf and piece; per node where its
+    // pieces sit in lines and how many it has
+    std::vector<unsigned int> lines;
+    std::vector<uint32_t> lineOwner;
+    std::vector<uint32_t> lineAt;
+    std::vector<uint8_t> lineCount;
+    std::vector<unsigned int> pieces;
+
+    // what the current update touched: leaves added (for balance), nodes whose
+    // lines need another look, vertices that appeared, corners that lost their
+    // last leaf, and lattice points whose vertex came or went
+    std::vector<int32_t> added, emitQueue;
+    std::vector<uint8_t> queued;
+    std::vector<uint32_t> appeared, vanished, touched;
+    // the moved bodies' pull to take back out and put back in, and the vertices
+    // that appeared, evaluated against all the bodies
+    std::vector<float> deltaX, deltaZ, deltaGM;
+    std::vector<float> freshX, freshZ, freshHeights;
+    unsigned int incrementalUpdates;
+    bool layered;
+    bool settled;
+
+    float nodeSize(const Node& node) const { return this->extent / (float)(1u << node.Depth); }
+    bool wantsSplit(const Node& node) const;
+    bool reaches(const Node& node, const std::vector<Reach>& moved) const;
+    void refit(int32_t index, const std::vector<Reach>* moved);
+    void split(int32_t index);
+    void merge(int32_t index);
+    void release(int32_t index);
+    void addLeaf(int32_t index);
+    void removeLeaf(int32_t index);
+    int32_t findLeaf(unsigned int col, unsigned int row) const;
+    void queue(int32_t index);
+    void balance();
+    bool commit();
+    bool emitLines(int32_t index);
+    void releaseLines(int32_t index);
+    void emitEdge(unsigned int i0, unsigned int j0, unsigned int i1, unsigned int j1);
+    void retarget(bool incremental);
+};
+
+#endif
@@ -0,0 +1,15 @@
+// include/BodyForce.h
+#ifndef BODY_FORCE_H
+#define BODY_FORCE_H
+
+#include "Simd.h"
+
+// Plummer-softened pull of a set of bodies on a run of particles, the force that
+// matches the grid's potential:
+// a[i] += sum_b( gm[b] * d / (|d|^2 + softening^2)^(3/2) ), d from particle i to body b.
+// particles go through the vector lanes and each body is broadcast to all of them
+void accumulateBodyAcceleration(const float* x, const float* y, const float* z, unsigned int count,
+                                const float* bodyX, const float* bodyY, const float* bodyZ, const float* bodyGM,
+                                unsigned int bodyCount, float softening, float* ax, float* ay, float* az);
+
+#endif
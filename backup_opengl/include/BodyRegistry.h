@@ -0,0 +1,69 @@
+// include/BodyRegistry.h
+#ifndef BODY_REGISTRY_H
+#define BODY_REGISTRY_H
+
+#include <cstdint>
+#include <vector>
+#include "Simd.h"
+
+class ThreadPool;
+
+// names one body for as long as it lives, however removals reshuffle the arrays.
+// a removed body's handle stops matching anything
+struct BodyHandle
+{
+    uint32_t Slot = UINT32_MAX;
+    uint32_t Generation = 0;
+};
+
+// every massive body of the scene as structure-of-arrays, packed in [0, Count)
+// so the grid field, the particle forces and the mutual step hand them straight
+// to the vector kernels. the arrays persist between frames and only grow on Add.
+// pinned bodies pull on the others but are moved by their owner (the sphere)
+class BodyRegistry
+{
+public:
+    BodyRegistry();
+
+    AlignedFloatArray PosX, PosY, PosZ;
+    AlignedFloatArray VelX, VelY, VelZ;
+    AlignedFloatArray GM;                 // gravitational parameter
+    std::vector<uint8_t> Pinned;
+    unsigned int Count;
+
+    BodyHandle Add(float x, float y, float z, float gm, float vx = 0.0f, float vy = 0.0f, float vz = 0.0f, bool pinned = false);
+    // the last body takes the removed one's index
+    bool Remove(BodyHandle handle);
+    void Clear();
+    void Reserve(unsigned int count);
+
+    bool Valid(BodyHandle handle) const;
+    // index into the arrays, UINT32_MAX for a stale handle
+    unsigned int Index(BodyHandle handle) const;
+
+    // moves a body by hand, typically a pinned one
+    void Set(BodyHandle handle, float x, float y, float z, float gm);
+
+    // one drift-kick-drift leapfrog step of the bodies' mutual Plummer gravity,
+    // vectorised over the bodies being pulled; the pool, when given, splits them
+    void Step(float dt, float softening, ThreadPool* pool = nullptr);
+
+    // G times the total energy: kinetic of the free bodies plus the softened
+    // potential of every pair. O(Count^2), meant for summaries
+    double Energy(float softening) const;
+
+    // bumped whenever a position or parameter changes, so caches can key on it.
+    // call Touch after writing the arrays directly
+    uint64_t Version() const { return this->version; }
+    void Touch() { this->version++; }
+
+private:
+    AlignedFloatArray accelX, accelY, accelZ;
+    std::vector<uint32_t> slotIndex;      // slot -> index, UINT32_MAX when free
+    std::vector<uint32_t> indexSlot;      // index -> slot
+    std::vector<uint32_t> generation;
+    std::vector<uint32_t> freeSlots;
+    uint64_t version;
+};
+
+#endif
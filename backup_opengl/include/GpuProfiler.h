@@ -0,0 +1,68 @@
+// include/GpuProfiler.h
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <vector>
+#include <GL/glew.h>
+
+const unsigned int GPU_PROFILER_FRAMES = 4;
+
+// GL timestamp queries around GPU passes, read back GPU_PROFILER_FRAMES frames
+// later so the CPU never waits on them. results land on the profiler's GPU
+// track, shifted onto the CPU clock. does nothing while the profiler is off or
+// the driver lacks timer queries
+class GpuProfiler
+{
+public:
+    GpuProfiler();
+    ~GpuProfiler();
+
+    // needs a current context
+    void Init();
+
+    // scopes may nest; name must be a string literal
+    void Begin(const char* name);
+    void End();
+
+    // call once per frame, after the last End
+    void EndFrame();
+
+private:
+    struct Scope {
+        const char* Name;
+        unsigned int Queries;   // index of the begin query; the end query follows it
+        bool Closed;
+    };
+    struct Frame {
+        std::vector<GLuint> Queries;
+        std::vector<Scope> Scopes;
+        unsigned int Used = 0;
+        GLuint LastIssued = 0;  // queries finish in order, so this one decides
+    };
+
+    Frame frames[GPU_PROFILER_FRAMES];
+    unsigned int current;
+    std::vector<unsigned int> open;
+    bool supported;
+    bool active;
+    long long clockOffset;      // CPU ns minus GPU ns
+    unsigned int framesSinceCalibration;
+
+    void collect(Frame& frame);
+    void calibrate();
+};
+
+class ScopedGpuTimer
+{
+public:
+    ScopedGpuTimer(GpuProfiler& profiler, const char* name) : profiler(profiler) { this->profiler.Begin(name); }
+    ~ScopedGpuTimer() { this->profiler.End(); }
+
+    ScopedGpuTimer(const ScopedGpuTimer&) = delete;
+    ScopedGpuTimer& operator=(const ScopedGpuTimer&) = delete;
+
+private:
+    GpuProfiler& profiler;
+};
+
+#endif
@@ -0,0 +1,43 @@
+// include/GridDisplacement.h
+#ifndef GRID_DISPLACEMENT_H
+#define GRID_DISPLACEMENT_H
+
+#include <vector>
+#include <GL/glew.h>
+#include "Physics.h"
+#include "BodyRegistry.h"
+#include "Shader.h"
+
+// must match MAX_GRID_BODIES and the GridBodies block in shaders/grid_gpu.vert
+const unsigned int MAX_GRID_BODIES = 32;
+const GLuint GRID_BODY_BINDING = 1;
+
+// GPU path for the grid: the lattice stays static on the GPU and grid_gpu.vert
+// computes each vertex's height from a small uniform block of bodies, so a frame
+// uploads O(bodies) bytes instead of the whole vertex array. a vertex shader
+// keeps no state between frames, so the easing the CPU path applies to every
+// height is applied here to the body positions and parameters instead
+class GridDisplacement
+{
+public:
+    GridDisplacement();
+    ~GridDisplacement();
+
+    // creates the uniform buffer and hooks shader's GridBodies block to it
+    void Init(const Shader& shader);
+
+    // eases the drawn bodies toward the first MAX_GRID_BODIES of bodies by
+    // smoothing and uploads them. a change in the number of bodies snaps instead
+    void Update(const BodyRegistry& bodies, float smoothing);
+
+    // jumps straight to bodies, e.g. when the GPU path is switched on
+    void Reset(const BodyRegistry& bodies);
+
+private:
+    GLuint UBO;
+    std::vector<GravitationalBody> drawnBodies;
+
+    void upload();
+};
+
+#endif
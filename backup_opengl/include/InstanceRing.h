@@ -0,0 +1,60 @@
+// include/InstanceRing.h
+#ifndef INSTANCE_RING_H
+#define INSTANCE_RING_H
+
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+
+// one particle as the instanced draw sees it: attribute 1 is the position,
+// attribute 2 the colour as normalised RGBA8
+struct ParticleInstance {
+    float X, Y, Z;
+    uint32_t Color;
+};
+
+uint32_t packInstanceColor(float r, float g, float b, float a);
+
+// per-instance vertex buffer streamed once per frame. with ARB_buffer_storage
+// it is one persistently mapped buffer split into RING_SEGMENTS segments, each
+// guarded by a fence, so the CPU writes one segment while the GPU still reads
+// the others. without it, the buffer is orphaned and refilled every frame.
+// GRAVITY_GL_PERSISTENT=0 forces the fallback
+class InstanceRing
+{
+public:
+    static const unsigned int RING_SEGMENTS = 3;
+
+    InstanceRing();
+    ~InstanceRing();
+
+    InstanceRing(const InstanceRing&) = delete;
+    InstanceRing& operator=(const InstanceRing&) = delete;
+
+    // creates the buffer and the instanced attributes on vao. called again when
+    // more room is needed
+    void Init(GLuint vao, unsigned int capacity);
+
+    // room for count instances (grows the buffer if needed); write them, then
+    // Commit before the draw and Fence right after it
+    ParticleInstance* Begin(unsigned int count);
+    void Commit(unsigned int count);
+    void Fence();
+
+    bool Persistent() const { return this->mapped != nullptr; }
+    unsigned int Capacity() const { return this->capacity; }
+
+private:
+    GLuint vao;
+    GLuint buffer;
+    unsigned int capacity;
+    unsigned int segment;
+    ParticleInstance* mapped;
+    GLsync fences[RING_SEGMENTS];
+    std::vector<ParticleInstance> staging;
+
+    void release();
+    void waitForSegment(unsigned int index);
+};
+
+#endif
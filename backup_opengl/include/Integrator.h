@@ -0,0 +1,40 @@
+// include/Integrator.h
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include <string>
+
+// Euler is the old semi-implicit step (kick, then drift). Leapfrog is
+// drift-kick-drift, second order with one force evaluation per step. Yoshida4
+// chains three leapfrogs with weights w1, w0, w1 for fourth order at three
+// force evaluations per step
+enum class Integrator { Euler, Leapfrog, Yoshida4 };
+
+// a step is Drift[0], Kick[0], Drift[1], Kick[1], ... Drift[Kicks], as fractions of dt
+struct IntegratorStages
+{
+    unsigned int Kicks;
+    float Drift[4];
+    float Kick[3];
+};
+
+const IntegratorStages& integratorStages(Integrator integrator);
+const char* integratorName(Integrator integrator);
+// "euler", "leapfrog" or "yoshida4"; false leaves integrator untouched
+bool parseIntegrator(const std::string& name, Integrator& integrator);
+
+// a step of dt is split so no particle moves more than Courant * length in one
+// substep, and none takes longer than AccelerationFactor * sqrt(length / |a|).
+// with the smoothing radius as length, Courant 1 keeps every pair the neighbour
+// grid should see inside its reach
+struct SubstepLimits
+{
+    float Courant = 1.0f;
+    float AccelerationFactor = 0.5f;
+    unsigned int MaxSubsteps = 4;
+};
+
+// substeps for dt given the fastest particle and the largest acceleration; at least 1
+unsigned int scheduleSubsteps(float dt, float maxSpeed, float maxAcceleration, float length, const SubstepLimits& limits);
+
+#endif
@@ -0,0 +1,45 @@
+// include/Octree.h
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Barnes-Hut tree over point masses. Build() copies the points in tree order, so
+// queries stay valid while the caller moves the originals around
+class Octree
+{
+public:
+    Octree();
+
+    void Build(const float* x, const float* y, const float* z, const float* mass, unsigned int count);
+
+    // softened field sum( m_j * d / (|d|^2 + eps^2)^(3/2) ) at position, where d points
+    // from position to each mass. multiply by G for an acceleration. a cell is
+    // treated as one mass once its size / distance drops below theta
+    glm::vec3 Field(const glm::vec3& position, float theta, float softening) const;
+
+    float TotalMass() const { return this->nodes.empty() ? 0.0f : this->nodes[0].Mass; }
+    glm::vec3 CenterOfMass() const { return this->nodes.empty() ? glm::vec3(0.0f) : this->nodes[0].CenterOfMass; }
+
+private:
+    struct Node {
+        glm::vec3 Center;
+        float HalfSize;
+        glm::vec3 CenterOfMass;
+        float Mass;
+        unsigned int First, Count;
+        unsigned int Children[8];   // 0 = empty octant, the root is never a child
+        bool Leaf;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<unsigned int> order;
+    std::vector<unsigned int> scratch;
+
+    std::vector<float> posX, posY, posZ, mass;
+
+    void buildNode(unsigned int nodeIndex, unsigned int depth, const float* x, const float* y, const float* z, const float* m);
+};
+
+#endif
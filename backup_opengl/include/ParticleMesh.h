@@ -0,0 +1,75 @@
+// include/ParticleMesh.h
+#ifndef PARTICLE_MESH_H
+#define PARTICLE_MESH_H
+
+#include <complex>
+#include <vector>
+#include "PotentialField.h"
+#include "ThreadPool.h"
+
+// particle-mesh gravity on a PotentialField's x/z lattice. masses are spread over
+// the lattice vertices with cloud-in-cell weights and convolved with the Plummer
+// kernel by FFT, O(masses + G log G) instead of a sum per vertex and mass. the mesh
+// is zero-padded to twice its size, so there are no periodic images, and the field
+// comes out exact on a margin of cells beyond the lattice edge as well.
+// the mass is taken as one sheet at its mass-weighted mean height: off the sheet the
+// field comes from kernels softened by the height above it, tabulated at a few
+// heights and interpolated between them. mass outside the lattice is summed directly.
+// nothing finer than a cell is resolved, so it suits an extended cloud, not point
+// masses: a body's well comes out too shallow and its pull off by tens of percent nearby
+class ParticleMesh
+{
+public:
+    // lattice must outlive the mesh
+    ParticleMesh(const PotentialField& lattice, float softening);
+
+    void Clear();
+    // adds scale * mass[i] at each point (gravitational parameters, G included)
+    void Deposit(const float* x, const float* y, const float* z, const float* mass, unsigned int count, float scale = 1.0f);
+    // convolves everything deposited since Clear
+    void Solve(ThreadPool* pool = nullptr);
+
+    // the solved field's acceleration at (x, y, z). outside the solved window the
+    // mesh mass counts as one point at its centre
+    void Acceleration(float x, float y, float z, float& ax, float& ay, float& az) const;
+
+    // scale * the potential on the sheet and its x/z slopes at every lattice vertex,
+    // the same quantities PotentialField::Evaluate and EvaluateGradient give for bodies
+    void Surface(float scale, float* heights, float* gradX, float* gradZ) const;
+
+    float TotalMass() const { return this->meshMass + this->farMass; }
+    float SheetHeight() const { return this->sheetY; }
+
+private:
+    const PotentialField* lattice;
+    float softening;
+    unsigned int columns, rows;
+    // padded size, a power of two at least twice the lattice
+    unsigned int padded;
+    // the window of vertices the padded convolution is exact on: columns
+    // windowCol .. windowCol + windowColumns - 1, likewise rows (may be negative)
+    int windowCol, windowRow;
+    unsigned int windowColumns, windowRows;
+
+    std::vector<float> mass;
+    float meshMass, farMass, sheetY, centreX, centreZ;
+    float weightedX, weightedY, weightedZ;
+    std::vector<float> farX, farY, farZ, farGM;
+
+    std::vector<std::complex<float>> twiddles, inverseTwiddles;
+    std::vector<unsigned int> bitReverse;
+    // kernel spectra, two real kernels packed per complex array
+    std::vector<std::vector<std::complex<float>>> kernels;
+    std::vector<std::complex<float>> spectrum, work;
+    // solved fields over the window: the potential, then x slope, z slope and
+    // vertical weight per height level
+    std::vector<std::vector<float>> fields;
+
+    void transform(std::complex<float>* data, bool inverse) const;
+    void transformRows(std::vector<std::complex<float>>& data, unsigned int first, unsigned int count,
+                       bool inverse, ThreadPool* pool) const;
+    void transformColumns(std::vector<std::complex<float>>& data, bool inverse, ThreadPool* pool) const;
+    float sample(const std::vector<float>& field, unsigned int cell, float fx, float fz) const;
+};
+
+#endif
@@ -0,0 +1,60 @@
+// include/ParticleStore.h
+#ifndef PARTICLE_STORE_H
+#define PARTICLE_STORE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Simd.h"
+
+struct Particle {
+    glm::vec3 Position, Velocity;
+    glm::vec4 Color;
+    float     Life;
+    float     Mass;
+
+    float Density;
+    float Pressure;
+    glm::vec3 Force;
+
+    Particle() : 
+        Position(0.0f), Velocity(0.0f), Color(1.0f), Life(0.0f), Mass(1.0f),
+        Density(0.0f), Pressure(0.0f), Force(0.0f) { }
+};
+
+// structure-of-arrays particle pool. the hot fields touched by the neighbor
+// loops live in their own arrays; colour, life and mass stay out of the way.
+// live particles are kept packed in [0, LiveCount), so loops never see a dead slot
+class ParticleStore
+{
+public:
+    ParticleStore() : LiveCount(0) { }
+
+    AlignedFloatArray PosX, PosY, PosZ;
+    AlignedFloatArray VelX, VelY, VelZ;
+    AlignedFloatArray ForceX, ForceY, ForceZ;
+    AlignedFloatArray Density, Pressure;
+
+    AlignedFloatArray Life, Mass;
+    std::vector<glm::vec4> Color;
+
+    unsigned int LiveCount;
+
+    void Resize(unsigned int count);
+    unsigned int Size() const { return (unsigned int)this->Life.size(); }
+
+    // O(1) spawn: claims the slot after the last live particle. false when the pool is full
+    bool Spawn(unsigned int& index);
+    // stable compaction: drops every live particle whose Life ran out and slides the
+    // survivors down in order, one pass however many died. particles stay in spawn
+    // order, so the draw order and the chunking of the passes never shuffle
+    void RemoveDead();
+
+    // accessor layer for callers that want a whole particle
+    Particle Get(unsigned int i) const;
+    void Set(unsigned int i, const Particle& particle);
+
+    glm::vec3 Position(unsigned int i) const { return glm::vec3(this->PosX[i], this->PosY[i], this->PosZ[i]); }
+    glm::vec3 Velocity(unsigned int i) const { return glm::vec3(this->VelX[i], this->VelY[i], this->VelZ[i]); }
+};
+
+#endif
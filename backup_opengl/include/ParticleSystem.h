@@ -3,47 +3,118 @@
 #define PARTICLE_SYSTEM_H
 
 #include <vector>
+#include <random>
+#include <cstdint>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include "Physics.h" 
+#include "ParticleStore.h"
+#include "SpatialHash.h"
+#include "ThreadPool.h"
+#include "Octree.h"
+#include "Snapshot.h"
+#include "InstanceRing.h"
+#include "Integrator.h"
+#include "PotentialField.h"
+#include "ParticleMesh.h"
+#include "BodyRegistry.h"
 
-struct Particle {
-    glm::vec3 Position, Velocity;
-    glm::vec4 Color;
-    float     Life;
-    float     Mass;
-
-    float Density;
-    float Pressure;
-    glm::vec3 Force;
-
-    Particle() : 
-        Position(0.0f), Velocity(0.0f), Color(1.0f), Life(0.0f), Mass(1.0f),
-        Density(0.0f), Pressure(0.0f), Force(0.0f) { }
-};
+const uint32_t DEFAULT_PARTICLE_SEED = 1;
 
 class ParticleSystem
 {
 public:
-    ParticleSystem(GLuint shader, unsigned int amount);
+    // threadCount 0 uses every hardware thread; results do not depend on it.
+    // shader 0 builds a simulation-only system that never touches GL (no Render)
+    ParticleSystem(GLuint shader, unsigned int amount, unsigned int threadCount = 0);
     ~ParticleSystem();
 
-    void Update(float dt, const std::vector<GravitationalBody>& allBodies, unsigned int newParticles, glm::vec3 spawnOffset = glm::vec3(0.0f));
+    // claims count slots for fresh jet particles around spawnOffset; requests past
+    // a full pool are counted in DroppedSpawns. Update calls it first
+    void Spawn(unsigned int count, glm::vec3 spawnOffset);
+    // kills every particle
+    void Clear();
+
+    // dt is split into LastSubsteps equal substeps by the Substeps limits, each
+    // advanced with Scheme
+    void Update(float dt, const BodyRegistry& bodies, unsigned int newParticles, glm::vec3 spawnOffset = glm::vec3(0.0f));
     
-    void Render(const glm::mat4& view, const glm::mat4& projection);
+    // view and projection come from the shared Frame block (FrameUniforms)
+    void Render();
+    // draws a recorded frame straight from its arrays, leaving the pool untouched.
+    // colour follows the jet a particle left by (sign of vx), alpha its life
+    void RenderFrame(const SnapshotFrame& frame);
+    // the scene's bodies as pale quads through the same pipeline; the first skip
+    // bodies (the sphere, drawn as a mesh) are left out
+    void RenderBodies(const BodyRegistry& bodies, unsigned int skip = 0);
+    // the same for a recorded frame's bodies
+    void RenderFrameBodies(const SnapshotFrame& frame, unsigned int skip = 0);
+
+    // restarts the spawn sequence. the same seed, dt and bodies give the same
+    // particles on any thread count
+    void Seed(uint32_t seed);
+
+    // read-only view of the pool; Particles().Get(i) returns one particle by value
+    const ParticleStore& Particles() const { return this->particles; }
+
+    unsigned int LiveCount() const { return this->particles.LiveCount; }
+    unsigned int ThreadCount() const { return this->workers.ThreadCount(); }
+    // the pool the particle passes run on, shared with the bodies' step
+    ThreadPool& Workers() { return this->workers; }
 
     glm::vec3 CenterOfMass;
     float     TotalMass;
 
+    // mutual gravity of the cloud through a Barnes-Hut tree rebuilt every Update.
+    // SelfGravityScale is the gravitational parameter per unit of particle mass,
+    // OpeningAngle the theta below which a cell is taken as a single mass
+    bool  SelfGravity;
+    float SelfGravityScale;
+    float OpeningAngle;
+
+    // particle-mesh self-gravity when set: with SelfGravity, every force evaluation
+    // deposits the cloud on this mesh and takes its pull from the solution in place
+    // of the tree. the few bodies are still summed directly
+    ParticleMesh* Mesh;
+
+    Integrator Scheme;
+    SubstepLimits Substeps;
+    unsigned int LastSubsteps;
+
+    // the grid surface particles bounce off, sampled when set and covering the
+    // particle; it must match the bodies passed to Update. elsewhere the surface
+    // is evaluated from the bodies directly
+    HeightField CollisionField;
+
+    // spawn requests refused because every slot was live
+    unsigned int DroppedSpawns;
+
 private:
-    std::vector<Particle> particles;
+    ParticleStore particles;
+    SpatialHash neighborGrid;
+    ThreadPool workers;
+    Octree cloudTree;
     unsigned int amount;
     GLuint shader;
+    GLuint quadVBO;
     GLuint VAO;
+    InstanceRing instances;
+    // the bodies get their own ring, so drawing them does not cycle the
+    // particles' segments a second time per frame
+    GLuint bodyVAO;
+    InstanceRing bodyInstances;
+    bool poolWasFull;
+    std::mt19937 random;
+    unsigned int spawnCount;
 
     void init();
-    unsigned int firstUnusedParticle();
-    void respawnParticle(Particle& particle, glm::vec3 spawnOffset);
+    void initRenderData();
+    void drawInstances(InstanceRing& ring, GLuint vao, unsigned int count);
+    void step(float dt, const BodyRegistry& bodies);
+    void computeForces(const BodyRegistry& bodies);
+    void integrate(float kick, float drift, float age, const BodyRegistry& bodies);
+    void removeDeadParticles();
+    void respawnParticle(unsigned int index, glm::vec3 spawnOffset);
 };
 
 #endif
\ No newline at end of file
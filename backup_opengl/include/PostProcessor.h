@@ -2,19 +2,38 @@
 #ifndef POST_PROCESSOR_H
 #define POST_PROCESSOR_H
 
+#include <vector>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include "Shader.h"
 
+const unsigned int DEFAULT_BLOOM_LEVELS = 6;
+
+// the scene is drawn off-screen at the window size times the render scale, then
+// tone-mapped and stretched to the window by the final pass.
+// bloom runs on a chain of half, quarter, ... resolution targets: the bright
+// pass is downsampled level by level with a 13-tap filter, then upsampled back
+// with a tent filter, each level added onto the next larger one
 class PostProcessor
 {
 public:
-    PostProcessor(GLuint postProcessShader, GLuint blurShader, unsigned int width, unsigned int height);
+    // width and height are the window framebuffer's; renderScale is the scene
+    // resolution relative to them, clamped to [0.25, 2]
+    PostProcessor(const Shader& postProcessShader, const Shader& downsampleShader, const Shader& upsampleShader,
+                  unsigned int width, unsigned int height, unsigned int bloomLevels = DEFAULT_BLOOM_LEVELS,
+                  float renderScale = 1.0f);
     ~PostProcessor();
 
     void BeginRender();
     void EndRender();
 
+    // only needed when the final pass will use bloom
     void ProcessBloom();
+
+    // reallocates every target for a new window size; 0 x 0 (minimised) is ignored
+    void Resize(unsigned int width, unsigned int height);
+    unsigned int SceneWidth() const { return this->Width; }
+    unsigned int SceneHeight() const { return this->Height; }
     
     void RenderFinalScene(bool enableBloom);
 
@@ -25,16 +44,33 @@ private:
     GLuint SceneTexture; 
     GLuint BrightnessTexture; 
 
-    GLuint PingPongFBO[2];
-    GLuint PingPongTexture[2];
+    struct BloomMip {
+        GLuint FBO;
+        GLuint Texture;
+        unsigned int Width, Height;
+    };
+    std::vector<BloomMip> BloomMips;
 
     GLuint QuadVAO;
     
     GLuint PostProcessShader;
-    GLuint BlurShader;
+    GLuint DownsampleShader;
+    GLuint UpsampleShader;
+
+    // uniform locations, resolved once in the constructor
+    GLint DownsampleTexelSize;
+    GLint UpsampleTexelSize;
+    GLint EnableBloom;
+    GLint BloomIntensity;
 
+    unsigned int OutputWidth, OutputHeight;
     unsigned int Width, Height;
+    float Scale;
+    unsigned int RequestedBloomLevels;
 
     void initRenderData();
+    void allocateTargets();
+    void createBloomChain(unsigned int levels);
+    void destroyBloomChain();
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+// include/PotentialField.h
+#ifndef POTENTIAL_FIELD_H
+#define POTENTIAL_FIELD_H
+
+#include "Simd.h"
+
+// a block of lattice vertices: columns [ColBegin, ColEnd) of rows [RowBegin, RowEnd)
+struct LatticeRegion
+{
+    unsigned int ColBegin = 0, ColEnd = 0;
+    unsigned int RowBegin = 0, RowEnd = 0;
+
+    bool Empty() const { return this->ColBegin >= this->ColEnd || this->RowBegin >= this->RowEnd; }
+    unsigned int VertexCount() const { return this->Empty() ? 0 : (this->ColEnd - this->ColBegin) * (this->RowEnd - this->RowBegin); }
+    // grows to the bounding block of both
+    void Merge(const LatticeRegion& other);
+};
+
+// Plummer potential of a set of bodies sampled on a fixed x/z lattice.
+// vertex (col, row) sits at (originX + col * spacing, originZ + row * spacing)
+// and is stored at row * columns + col, the layout of both grid meshes
+class PotentialField
+{
+public:
+    PotentialField(unsigned int columns, unsigned int rows, float originX, float originZ, float spacing);
+
+    unsigned int Columns() const { return this->columns; }
+    unsigned int Rows() const { return this->rows; }
+    unsigned int VertexCount() const { return this->columns * this->rows; }
+    float OriginX() const { return this->originX; }
+    float OriginZ() const { return this->originZ; }
+    float Spacing() const { return this->spacing; }
+
+    const float* X() const { return this->latticeX.data(); }
+    const float* Z() const { return this->latticeZ.data(); }
+
+    // heights[v] = scale * sum_b( -gm[b] / sqrt(dx^2 + dz^2 + softening^2) ) for every vertex.
+    // heights must hold VertexCount() floats
+    void Evaluate(const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                  float softening, float scale, float* heights) const;
+
+    // the analytic x and z derivatives of the same heights,
+    // scale * sum_b( gm[b] * d / (dx^2 + dz^2 + softening^2)^(3/2) )
+    void EvaluateGradient(const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                          float softening, float scale, float* gradX, float* gradZ) const;
+
+    // Evaluate's heights at count arbitrary (x, z) points instead of the lattice
+    static void EvaluatePoints(const float* x, const float* z, unsigned int count,
+                               const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                               float softening, float scale, float* heights);
+
+    // adds the bodies' heights and gradients onto the vertices of region only,
+    // leaving the rest alone; a negative gm takes a body's earlier pull back out.
+    // works in scratch arrays the field keeps, so one call at a time per field
+    void AccumulateRegion(const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                          float softening, float scale, const LatticeRegion& region,
+                          float* heights, float* gradX, float* gradZ) const;
+
+    LatticeRegion All() const;
+    // every vertex within radius of the box [minX, maxX] x [minZ, maxZ] (and a few
+    // corner vertices beyond), clipped to the lattice
+    LatticeRegion RegionAround(float minX, float minZ, float maxX, float maxZ, float radius) const;
+
+    // the cell holding (x, z) as its first vertex and the fractions across it;
+    // false outside the lattice
+    bool Locate(float x, float z, unsigned int& vertex, float& fx, float& fz) const;
+
+private:
+    unsigned int columns, rows;
+    float originX, originZ, spacing;
+
+    AlignedFloatArray latticeX;
+    AlignedFloatArray latticeZ;
+    // AccumulateRegion's gathered region and its results, grown to the largest
+    // region seen so the per-step patches don't allocate
+    mutable AlignedFloatArray scratchX, scratchZ, scratchHeights, scratchGradX, scratchGradZ;
+};
+
+// per-vertex heights and gradients on a PotentialField lattice, borrowed from
+// whoever evaluated them
+struct HeightField
+{
+    const PotentialField* Lattice = nullptr;
+    const float* Heights = nullptr;
+    const float* GradX = nullptr;
+    const float* GradZ = nullptr;
+
+    // bilinear height and gradient at (x, z); false when unset or outside the lattice
+    bool Sample(float x, float z, float& height, float& gradX, float& gradZ) const;
+};
+
+#endif
@@ -0,0 +1,87 @@
+// include/Profiler.h
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// scoped CPU timers feeding a fixed ring of the most recent events. while the
+// profiler is off a scope costs one relaxed load; GRAVITY_NO_PROFILER compiles
+// the scopes out entirely. names must be string literals (only the pointer is kept)
+const unsigned int PROFILER_CAPACITY = 1u << 16;
+const uint32_t PROFILER_GPU_TRACK = 1000;
+
+struct ProfileEvent
+{
+    const char* Name;
+    uint64_t Start;      // ns since the profiler was first enabled
+    uint64_t Duration;   // ns
+    uint32_t Track;      // recording thread, or PROFILER_GPU_TRACK
+};
+
+// milliseconds over the most recent events of one name
+struct ProfileStats
+{
+    unsigned int Count = 0;
+    double P50 = 0.0;
+    double P99 = 0.0;
+};
+
+class Profiler
+{
+public:
+    static void SetEnabled(bool enabled);
+    static bool Enabled() { return enabled.load(std::memory_order_relaxed); }
+
+    static uint64_t Now();
+    static uint32_t CurrentTrack();
+    static void Record(const char* name, uint64_t start, uint64_t duration, uint32_t track);
+
+    // scans back through the ring for the last `last` events called name
+    static ProfileStats Stats(const char* name, unsigned int last = 240, uint32_t track = UINT32_MAX);
+
+    // the ring as Chrome trace JSON (chrome://tracing, Perfetto). false if the file can't be written
+    static bool WriteChromeTrace(const std::string& path);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const char* name)
+        : name(Profiler::Enabled() ? name : nullptr), start(this->name ? Profiler::Now() : 0) { }
+    ~ScopedTimer() { this->Stop(); }
+
+    // ends the scope early; later calls and the destructor do nothing
+    void Stop()
+    {
+        if (this->name)
+            Profiler::Record(this->name, this->start, Profiler::Now() - this->start, Profiler::CurrentTrack());
+        this->name = nullptr;
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// PROFILE_TIMER names the timer so PROFILE_STOP can end it before the scope does
+#ifdef GRAVITY_NO_PROFILER
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_TIMER(var, name) ((void)0)
+#define PROFILE_STOP(var) ((void)0)
+#else
+#define PROFILE_SCOPE(name) ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_TIMER(var, name) ScopedTimer var(name)
+#define PROFILE_STOP(var) var.Stop()
+#endif
+
+#endif
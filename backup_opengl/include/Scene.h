@@ -0,0 +1,18 @@
+// include/Scene.h
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <string>
+#include "BodyRegistry.h"
+
+// adds the bodies of a scene file to bodies. one directive per line, # starts a comment:
+//   body X Y Z GM [VX VY VZ] [pinned]
+//   disk COUNT INNER OUTER Y GM [SEED]
+// a disk scatters COUNT bodies of parameter GM evenly over the annulus at height Y,
+// each on a circular orbit around the parameter of everything listed before it,
+// taken as sitting at the origin. the same SEED (default 1) gives the same disk,
+// and COUNT runs from 0 to 1000000.
+// false, with nothing added, when the file can't be read or a line is malformed
+bool LoadScene(const std::string& path, BodyRegistry& bodies);
+
+#endif
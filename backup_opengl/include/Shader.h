@@ -0,0 +1,65 @@
+// include/Shader.h
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <string>
+#include <unordered_map>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// binding point of the per-frame block (see FrameUniforms)
+const GLuint FRAME_BLOCK_BINDING = 0;
+
+// a linked program plus every active uniform location, read once with
+// glGetActiveUniform right after linking. call sites resolve the locations
+// they need at setup and keep the GLint, so drawing never looks up a name
+class Shader
+{
+public:
+    // loads and links through loadShader; ID stays 0 if that fails
+    Shader(const char* vertexPath, const char* fragmentPath);
+    ~Shader();
+
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
+    GLuint ID;
+
+    void Use() const { glUseProgram(this->ID); }
+
+    // cached location, -1 (with a warning) for names that are not active.
+    // arrays answer to both "name" and "name[0]"
+    GLint Uniform(const std::string& name) const;
+
+    // hooks a uniform block to a binding point; false if the program lacks it
+    bool BindBlock(const char* blockName, GLuint binding) const;
+
+    // checks every cached location against glGetUniformLocation and the
+    // active-uniform count; prints and returns false on any mismatch
+    bool VerifyUniforms() const;
+
+    unsigned int UniformCount() const { return (unsigned int)this->uniforms.size(); }
+
+private:
+    std::string name;
+    std::unordered_map<std::string, GLint> uniforms;
+
+    void reflect();
+};
+
+// the "Frame" uniform block every scene shader shares: view, projection and the
+// camera position, uploaded once per frame instead of once per program
+class FrameUniforms
+{
+public:
+    FrameUniforms();
+    ~FrameUniforms();
+
+    void Init();
+    void Update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos);
+
+private:
+    GLuint UBO;
+};
+
+#endif
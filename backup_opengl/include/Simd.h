@@ -0,0 +1,42 @@
+// include/Simd.h
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <vector>
+#include <cstddef>
+#include <new>
+
+// widest instruction set the running CPU offers to the vector kernels.
+// GRAVITY_SIMD=scalar|sse|avx2 in the environment caps it (handy to compare paths)
+enum class SimdLevel { Scalar, SSE, AVX2 };
+
+SimdLevel DetectSimdLevel();
+const char* SimdLevelName(SimdLevel level);
+
+// 32-byte aligned storage so every array can be walked with full-width vector loads
+template <typename T, std::size_t Alignment>
+struct AlignedAllocator
+{
+    typedef T value_type;
+    template <typename U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+    AlignedAllocator() noexcept { }
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept { }
+
+    T* allocate(std::size_t n)
+    {
+        void* ptr = ::operator new(n * sizeof(T), std::align_val_t(Alignment));
+        return static_cast<T*>(ptr);
+    }
+    void deallocate(T* ptr, std::size_t) noexcept
+    {
+        ::operator delete(ptr, std::align_val_t(Alignment));
+    }
+
+    template <typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template <typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+typedef std::vector<float, AlignedAllocator<float, 32>> AlignedFloatArray;
+
+#endif
@@ -0,0 +1,137 @@
+// include/Simulation.h
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Physics.h"
+#include "ParticleSystem.h"
+#include "BodyRegistry.h"
+#include "AdaptiveGrid.h"
+#include "SnapshotWriter.h"
+#include "SnapshotReader.h"
+#include "PostProcessor.h"
+
+// the deformation grid is a square of GRID_EXTENT on a side, GRID_SIZE cells
+// of GRID_SCALE across unless --grid-size gives another count for the same square
+const int GRID_SIZE = 100;
+const float GRID_SCALE = 0.5f;
+const float GRID_EXTENT = GRID_SIZE * GRID_SCALE;
+const unsigned int MAX_GRID_SIZE = 2048;
+const float GRID_SMOOTHING_FACTOR = 0.08f;
+// --grid-lod cells run from GRID_EXTENT / 2^3 down to / 2^8, the finest about
+// half the default grid's spacing
+const unsigned int GRID_LOD_MIN_DEPTH = 3;
+const unsigned int GRID_LOD_MAX_DEPTH = 8;
+
+const unsigned int PARTICLE_POOL_SIZE = 5500;
+const unsigned int PARTICLES_PER_STEP = 10;
+
+// cells per side of the grid and their size, as configureGrid last set them
+unsigned int gridSize();
+float gridSpacing();
+
+// (gridSize() + 1)^2 xyz vertices at y = 0 plus the GL_LINES index list
+void buildGridMesh(std::vector<float>& vertices, std::vector<unsigned int>& indices);
+void calculateTargetDeformation(std::vector<float>& targetVertices, const BodyRegistry& bodies);
+
+// the sphere pulls harder the lower it sits
+float sphereGravitationalParameter(const glm::vec3& spherePos);
+
+// moves the sphere's body to spherePos, with the parameter that height gives it
+void placeSphere(BodyRegistry& bodies, BodyHandle sphere, const glm::vec3& spherePos);
+
+// one step shared by the window loop and --headless: the bodies' mutual gravity,
+// then the particles in their field. particles collide with the same cached
+// lattice field the grid target is read from; with a particle mesh the cloud's
+// layer off the mesh, from the step before, is added to the bodies' own field
+void stepSimulation(ParticleSystem& particles, BodyRegistry& bodies, const glm::vec3& spawnOffset, float dt);
+
+// CPU grid path: refreshes the target heights the bodies changed and eases the
+// drawn grid toward them. the same pair of arrays must come back every call, since
+// only the still-moving part is touched; false once nothing changed (grid settled)
+bool deformGrid(const BodyRegistry& bodies, std::vector<float>& gridVertices, std::vector<float>& targetGridVertices);
+
+// --grid-lod path: refits the adaptive grid to the bodies and eases it. with a
+// particle mesh the cloud's layer is added under its vertices, though the cells
+// only refine for the bodies. false once nothing changed; resized is set when the
+// vertex or line lists changed, not only the heights
+bool deformLodGrid(const BodyRegistry& bodies, AdaptiveGrid& grid, bool& resized);
+
+struct CommandLineOptions
+{
+    bool Headless = false;
+    unsigned int Steps = 3600;
+    float TimeStep = 1.0f / 60.0f;
+    unsigned int Threads = 0;
+    std::string ScenePath;
+    bool MeshGravity = false;
+    Integrator Scheme = Integrator::Leapfrog;
+    unsigned int MaxSubsteps = 4;
+    uint32_t Seed = DEFAULT_PARTICLE_SEED;
+
+    std::string RecordPath;
+    bool RecordAppend = false;
+    bool RecordHalf = false;
+    unsigned int RecordEvery = 1;
+
+    std::string ReplayPath;
+    unsigned int ReplayFrame = 0;
+
+    unsigned int GridSize = GRID_SIZE;
+    bool GpuGrid = false;
+    bool LodGrid = false;
+    bool CheckShaders = false;
+    unsigned int BloomLevels = DEFAULT_BLOOM_LEVELS;
+    float RenderScale = 1.0f;
+
+    bool Profile = false;
+    std::string TracePath;
+};
+
+// --headless [--steps N] [--dt SECONDS] [--threads N], --scene PATH, --gravity direct|mesh
+// --integrator euler|leapfrog|yoshida4, --max-substeps N, --seed N
+// --record PATH [--record-append] [--record-half] [--record-every N]
+// --replay PATH [--replay-frame N]
+// --grid-size N, --grid-gpu, --grid-lod, --check-shaders, --bloom-levels N, --render-scale F
+// --profile, --trace PATH (implies --profile)
+CommandLineOptions parseCommandLine(int argc, char* argv[]);
+
+// --grid-size: rebuilds the grid's lattice field, its cached heights and the
+// particle mesh at options.GridSize cells over the same square. call before the
+// first step; false for a size outside [2, MAX_GRID_SIZE]
+bool configureGrid(const CommandLineOptions& options);
+
+// applies the integrator, substep, seed and gravity options to a particle system
+void configureParticles(ParticleSystem& particles, const CommandLineOptions& options);
+
+// the sphere first, pinned since its owner moves it, then the bodies of
+// options.ScenePath when one was given. false when the scene can't be loaded
+bool setupBodies(BodyRegistry& bodies, BodyHandle& sphere, const CommandLineOptions& options);
+
+// opens options.RecordPath when one was given; false only when that fails
+bool openRecording(SnapshotWriter& writer, const CommandLineOptions& options);
+// queues the live particles, every body (the sphere first) and the smoothed grid
+// heights as one frame
+void recordFrame(SnapshotWriter& writer, const ParticleSystem& particles, const BodyRegistry& bodies,
+                 const std::vector<float>& gridVertices, uint64_t step, double time);
+void closeRecording(SnapshotWriter& writer);
+
+// puts a recorded frame's sphere and grid heights into the scene's arrays, for the
+// headless replay (the window uploads the heights straight from the frame). heights
+// are only taken when the recording used this grid's dimensions
+void applyReplayFrame(const SnapshotFrame& frame, glm::vec3& spherePos, std::vector<float>& gridVertices);
+
+// step number step of a headless run: puts the sphere on its scripted orbit (a
+// slow circle that also bobs up and down) and steps the simulation. returns
+// where the sphere went
+glm::vec3 stepScripted(ParticleSystem& particles, BodyRegistry& bodies, BodyHandle sphere, unsigned int step, float dt);
+
+// runs options.Steps fixed steps with the sphere on a scripted orbit, no window
+// or GL context, and prints a summary to stdout
+int runHeadless(const CommandLineOptions& options);
+// with --replay: walks every recorded frame without drawing and prints the read rate
+int runReplayHeadless(const CommandLineOptions& options);
+
+#endif
@@ -0,0 +1,115 @@
+// include/Snapshot.h
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+
+// on-disk layout of a recorded run (little-endian):
+//
+//   SnapshotFileHeader
+//   frame 0: SnapshotFrameHeader, then ChunkCount x (SnapshotChunkHeader + payload)
+//   frame 1 ...
+//   uint64_t frameOffset[FrameCount]
+//   SnapshotFooter
+//
+// every header and every payload starts on a 16-byte boundary, so a mapped file
+// can hand float32 chunks straight to the renderer
+
+const char SNAPSHOT_FILE_MAGIC[8]   = { 'G', 'R', 'V', 'S', 'N', 'A', 'P', '1' };
+const char SNAPSHOT_FOOTER_MAGIC[8] = { 'G', 'R', 'V', 'I', 'N', 'D', 'X', '1' };
+const uint32_t SNAPSHOT_VERSION = 1;
+const uint32_t SNAPSHOT_FRAME_MAGIC = 0x4D415246; // "FRAM"
+const uint32_t SNAPSHOT_ALIGNMENT = 16;
+
+enum SnapshotChunkType : uint32_t {
+    CHUNK_POSITION_X = 1,
+    CHUNK_POSITION_Y,
+    CHUNK_POSITION_Z,
+    CHUNK_VELOCITY_X,
+    CHUNK_VELOCITY_Y,
+    CHUNK_VELOCITY_Z,
+    CHUNK_DENSITY,
+    CHUNK_LIFE,
+    CHUNK_GRID_HEIGHT,
+    CHUNK_GRID_LATTICE,       // originX, originZ, spacing; always float32
+    CHUNK_BODIES              // x, y, z, gravitational parameter per body; always float32
+};
+
+enum SnapshotEncoding : uint32_t {
+    ENCODING_FLOAT32 = 0,
+    ENCODING_FLOAT16 = 1
+};
+
+struct SnapshotFileHeader {
+    char     Magic[8];
+    uint32_t Version;
+    uint32_t Reserved;
+};
+
+struct SnapshotFrameHeader {
+    uint32_t Magic;
+    uint32_t ChunkCount;
+    uint64_t Step;            // simulation step the frame was taken at
+    double   Time;
+    uint32_t ParticleCount;
+    uint32_t GridColumns;
+    uint32_t GridRows;
+    uint32_t Reserved;
+    uint64_t FrameBytes;      // header included, up to the next frame
+};
+
+struct SnapshotChunkHeader {
+    uint32_t Type;
+    uint32_t Encoding;
+    uint32_t Count;
+    uint32_t PayloadBytes;    // padded to SNAPSHOT_ALIGNMENT
+};
+
+struct SnapshotFooter {
+    uint64_t FrameCount;
+    uint64_t IndexOffset;
+    char     Magic[8];
+    uint64_t Reserved;
+};
+
+static_assert(sizeof(SnapshotFileHeader) == 16, "snapshot header layout");
+static_assert(sizeof(SnapshotFrameHeader) == 48, "snapshot frame header layout");
+static_assert(sizeof(SnapshotChunkHeader) == 16, "snapshot chunk header layout");
+static_assert(sizeof(SnapshotFooter) == 32, "snapshot footer layout");
+
+inline uint64_t snapshotAlign(uint64_t bytes)
+{
+    return (bytes + SNAPSHOT_ALIGNMENT - 1) & ~(uint64_t)(SNAPSHOT_ALIGNMENT - 1);
+}
+
+// borrowed view of one frame of state: what SnapshotWriter::Submit takes and
+// SnapshotReader::ReadFrame hands back. null arrays are absent from the frame
+struct SnapshotFrame
+{
+    uint64_t Step = 0;
+    double   Time = 0.0;
+
+    unsigned int ParticleCount = 0;
+    const float* PosX = nullptr;
+    const float* PosY = nullptr;
+    const float* PosZ = nullptr;
+    const float* VelX = nullptr;
+    const float* VelY = nullptr;
+    const float* VelZ = nullptr;
+    const float* Density = nullptr;
+    const float* Life = nullptr;
+
+    unsigned int GridColumns = 0, GridRows = 0;
+    const float* GridHeights = nullptr;
+    unsigned int GridStride = 1;         // floats between consecutive heights (3 for xyz vertices)
+    float GridOriginX = 0.0f, GridOriginZ = 0.0f, GridSpacing = 0.0f;   // spacing 0: lattice unknown
+
+    unsigned int BodyCount = 0;
+    const float* Bodies = nullptr;       // x, y, z, gravitational parameter per body
+};
+
+// IEEE 754 binary16 conversion, round to nearest even
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+#endif
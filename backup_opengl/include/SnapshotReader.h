@@ -0,0 +1,53 @@
+// include/SnapshotReader.h
+#ifndef SNAPSHOT_READER_H
+#define SNAPSHOT_READER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Snapshot.h"
+
+// read-only view of a recorded run. the whole file is memory-mapped, so
+// seeking is an index lookup and float32 chunks are handed out as pointers
+// into the mapping without a copy. float16 chunks are widened into scratch
+// arrays owned by the reader
+class SnapshotReader
+{
+public:
+    SnapshotReader();
+    ~SnapshotReader();
+
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return this->data != nullptr; }
+
+    unsigned int FrameCount() const { return (unsigned int)this->frameCount; }
+
+    // fills frame with pointers valid until the next ReadFrame or Close.
+    // grid heights come back with GridStride 1
+    bool ReadFrame(unsigned int index, SnapshotFrame& frame);
+
+    // playback helper: consumes elapsed seconds by the recorded time between
+    // frames and returns the frame to show, wrapping to 0 after the last one
+    unsigned int Advance(unsigned int index, double& elapsed) const;
+
+private:
+    const unsigned char* data;
+    uint64_t size;
+    const uint64_t* offsets;
+    uint64_t frameCount;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+
+    std::vector<float> scratch[CHUNK_BODIES + 1];
+
+    bool validate();
+    double frameTime(unsigned int index) const;
+};
+
+#endif
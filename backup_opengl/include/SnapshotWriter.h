@@ -0,0 +1,69 @@
+// include/SnapshotWriter.h
+#ifndef SNAPSHOT_WRITER_H
+#define SNAPSHOT_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Snapshot.h"
+
+// streams frames to a snapshot file (see Snapshot.h) from a background thread.
+// Submit encodes the frame into one of two buffers and hands it to the I/O
+// thread; if both buffers are still waiting on the disk the frame is dropped
+// instead of stalling the simulation. Close writes the index footer
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(bool halfPrecision = false);
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // append keeps the frames of an existing file and adds new ones after them
+    bool Open(const std::string& path, bool append = false);
+    void Close();
+    bool IsOpen() const { return this->file != nullptr; }
+
+    // false when the frame was dropped (both buffers busy, or the writer failed)
+    bool Submit(const SnapshotFrame& frame);
+
+    // frames on disk, counting the ones an appended file already had
+    uint64_t FramesWritten();
+    uint64_t FramesDropped;
+
+    // particle and grid chunks are stored as float16
+    bool HalfPrecision;
+
+private:
+    static const int BUFFER_COUNT = 2;
+
+    struct FrameBuffer {
+        std::vector<unsigned char> Bytes;
+        bool Busy = false;
+    };
+
+    FrameBuffer buffers[BUFFER_COUNT];
+    int queued[BUFFER_COUNT];
+    int queueHead, queueSize;
+
+    std::FILE* file;
+    uint64_t writeOffset;
+    std::vector<uint64_t> frameOffsets;
+    bool failed;
+    bool stopping;
+
+    std::thread ioThread;
+    std::mutex lock;
+    std::condition_variable frameReady;
+
+    void ioLoop();
+    void encode(const SnapshotFrame& frame, std::vector<unsigned char>& bytes) const;
+    bool readIndex();
+};
+
+#endif
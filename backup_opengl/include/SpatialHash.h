@@ -0,0 +1,75 @@
+// include/SpatialHash.h
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <vector>
+#include <cmath>
+
+class ParticleStore;
+
+// cell list over an unbounded domain: cells of size cellSize are hashed into a
+// power-of-two table and particles are counting-sorted by bucket every Build()
+class SpatialHash
+{
+public:
+    explicit SpatialHash(float cellSize);
+
+    void Build(const ParticleStore& particles);
+
+    // visits every particle index stored in the 27 cells around (x, y, z).
+    // callers still have to test the distance (buckets may hold other cells)
+    template <typename Func>
+    void ForEachNeighbor(float x, float y, float z, Func&& func) const;
+
+private:
+    float cellSize;
+    float invCellSize;
+    unsigned int tableMask;
+
+    std::vector<unsigned int> cellStart;
+    std::vector<unsigned int> cellEntries;
+    std::vector<unsigned int> particleBucket;
+    std::vector<unsigned int> bucketCursor;
+
+    int cellCoord(float v) const { return (int)std::floor(v * this->invCellSize); }
+    unsigned int bucket(int cx, int cy, int cz) const;
+};
+
+inline unsigned int SpatialHash::bucket(int cx, int cy, int cz) const
+{
+    unsigned int h = ((unsigned int)cx * 73856093u) ^ ((unsigned int)cy * 19349663u) ^ ((unsigned int)cz * 83492791u);
+    return h & this->tableMask;
+}
+
+template <typename Func>
+void SpatialHash::ForEachNeighbor(float x, float y, float z, Func&& func) const
+{
+    if (this->cellEntries.empty()) return;
+
+    int cx = cellCoord(x);
+    int cy = cellCoord(y);
+    int cz = cellCoord(z);
+
+    // two of the 27 cells can land in the same bucket, visit each bucket once
+    unsigned int visited[27];
+    int visitedCount = 0;
+
+    for (int dz = -1; dz <= 1; ++dz)
+    for (int dy = -1; dy <= 1; ++dy)
+    for (int dx = -1; dx <= 1; ++dx)
+    {
+        unsigned int b = bucket(cx + dx, cy + dy, cz + dz);
+
+        bool seen = false;
+        for (int k = 0; k < visitedCount; ++k) {
+            if (visited[k] == b) { seen = true; break; }
+        }
+        if (seen) continue;
+        visited[visitedCount++] = b;
+
+        for (unsigned int e = this->cellStart[b]; e < this->cellStart[b + 1]; ++e)
+            func(this->cellEntries[e]);
+    }
+}
+
+#endif
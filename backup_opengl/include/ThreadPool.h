@@ -0,0 +1,62 @@
+// include/ThreadPool.h
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// persistent workers for data-parallel loops. each ParallelFor splits its range
+// into chunks dealt round-robin to per-thread deques; a thread works its own
+// deque from the back and steals from the front of the others when it runs dry.
+// the calling thread takes part, so a pool of N threads starts N-1 workers
+class ThreadPool
+{
+public:
+    typedef std::function<void(unsigned int begin, unsigned int end)> RangeFunc;
+
+    // threadCount 0 picks std::thread::hardware_concurrency()
+    explicit ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int ThreadCount() const { return (unsigned int)this->queues.size(); }
+
+    // runs func over [begin, end) in chunks of at most grain items and returns when
+    // every chunk is done. chunks never overlap, so per-item writes need no locking
+    void ParallelFor(unsigned int begin, unsigned int end, unsigned int grain, const RangeFunc& func);
+
+private:
+    struct Range { unsigned int Begin, End; };
+    struct WorkQueue {
+        std::mutex Lock;
+        std::deque<Range> Tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+
+    const RangeFunc* job;
+    std::atomic<unsigned int> pending;
+
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    unsigned int generation;
+    bool stopping;
+
+    std::mutex doneLock;
+    std::condition_variable done;
+
+    void workerLoop(unsigned int self);
+    void drain(unsigned int self);
+    bool popOrSteal(unsigned int self, Range& task);
+};
+
+#endif
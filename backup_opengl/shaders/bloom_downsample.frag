@@ -0,0 +1,34 @@
+// shaders/bloom_downsample.frag
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 sourceTexelSize;
+
+// 13-tap downsample: four overlapping 2x2 boxes around the centre plus one on
+// it, which keeps a half-size target from shimmering as bright spots move
+void main()
+{
+    vec2 t = sourceTexelSize;
+    vec3 a = texture(source, TexCoords + t * vec2(-2.0,  2.0)).rgb;
+    vec3 b = texture(source, TexCoords + t * vec2( 0.0,  2.0)).rgb;
+    vec3 c = texture(source, TexCoords + t * vec2( 2.0,  2.0)).rgb;
+    vec3 d = texture(source, TexCoords + t * vec2(-2.0,  0.0)).rgb;
+    vec3 e = texture(source, TexCoords).rgb;
+    vec3 f = texture(source, TexCoords + t * vec2( 2.0,  0.0)).rgb;
+    vec3 g = texture(source, TexCoords + t * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(source, TexCoords + t * vec2( 0.0, -2.0)).rgb;
+    vec3 i = texture(source, TexCoords + t * vec2( 2.0, -2.0)).rgb;
+    vec3 j = texture(source, TexCoords + t * vec2(-1.0,  1.0)).rgb;
+    vec3 k = texture(source, TexCoords + t * vec2( 1.0,  1.0)).rgb;
+    vec3 l = texture(source, TexCoords + t * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(source, TexCoords + t * vec2( 1.0, -1.0)).rgb;
+
+    vec3 result = e * 0.125;
+    result += (a + c + g + i) * 0.03125;
+    result += (b + d + f + h) * 0.0625;
+    result += (j + k + l + m) * 0.125;
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,24 @@
+// shaders/bloom_upsample.frag
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 sourceTexelSize;
+
+// 3x3 tent filter; the result is blended additively onto the next larger level
+void main()
+{
+    vec2 t = sourceTexelSize;
+    vec3 result = texture(source, TexCoords).rgb * 4.0;
+    result += (texture(source, TexCoords + vec2(-t.x, 0.0)).rgb +
+               texture(source, TexCoords + vec2( t.x, 0.0)).rgb +
+               texture(source, TexCoords + vec2(0.0, -t.y)).rgb +
+               texture(source, TexCoords + vec2(0.0,  t.y)).rgb) * 2.0;
+    result += texture(source, TexCoords + vec2(-t.x, -t.y)).rgb +
+              texture(source, TexCoords + vec2( t.x, -t.y)).rgb +
+              texture(source, TexCoords + vec2(-t.x,  t.y)).rgb +
+              texture(source, TexCoords + vec2( t.x,  t.y)).rgb;
+    FragColor = vec4(result / 16.0, 1.0);
+}
@@ -1,11 +1,19 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+// a replay's recorded height over the flat lattice; the other grids leave the
+// array off and read the default 0
+layout (location = 1) in float aHeight;
+
+// per-frame block, filled by FrameUniforms (include/Shader.h)
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPos;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * model * vec4(aPos + vec3(0.0, aHeight, 0.0), 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// per-frame block, filled by FrameUniforms (include/Shader.h)
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPos;
+};
+
+uniform mat4 model;
+
+uniform float softening;
+uniform float visualScale;
+
+// keep in sync with MAX_GRID_BODIES in include/GridDisplacement.h
+const int MAX_GRID_BODIES = 32;
+
+layout (std140) uniform GridBodies {
+    vec4 body[MAX_GRID_BODIES];   // xyz position, w gravitational parameter
+    ivec4 bodyCount;              // x is used
+};
+
+// the same softened potential the CPU path evaluates into the grid heights
+void main()
+{
+    float potential = 0.0;
+    for (int b = 0; b < bodyCount.x; ++b) {
+        vec2 d = aPos.xz - body[b].xz;
+        potential -= body[b].w * inversesqrt(dot(d, d) + softening * softening);
+    }
+
+    vec3 displaced = vec3(aPos.x, potential * visualScale, aPos.z);
+    gl_Position = projection * view * model * vec4(displaced, 1.0);
+}
@@ -1,15 +1,20 @@
 #version 330 core
 layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec3 aOffset;
+layout (location = 2) in vec4 aColor;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per-frame block, filled by FrameUniforms (include/Shader.h)
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPos;
+};
 
-uniform vec4 particleColor;
 out vec4 v_Color;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos.x, aPos.y, 0.0, 1.0);
-    v_Color = particleColor;
-}
\ No newline at end of file
+    // the quad stays in the world xy plane around the particle, as before
+    gl_Position = projection * view * vec4(aOffset + vec3(aPos, 0.0), 1.0);
+    v_Color = aColor;
+}
@@ -8,17 +8,17 @@ uniform sampler2D sceneTexture;
 uniform sampler2D bloomTexture; 
 
 uniform bool enableBloom;
+uniform float bloomIntensity = 1.0;
 uniform float exposure = 1.0;
 
 void main()
 {
     vec3 hdrColor = texture(sceneTexture, TexCoords).rgb;
     
-    vec3 bloomColor = texture(bloomTexture, TexCoords).rgb;
-    
     if(enableBloom)
     {
-        hdrColor += bloomColor;
+        vec3 bloomColor = texture(bloomTexture, TexCoords).rgb;
+        hdrColor += bloomColor * bloomIntensity;
     }
     
     vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
@@ -4,10 +4,16 @@ out vec4 FragColor;
 in vec3 FragPos;
 in vec3 Normal;
 
+// per-frame block, filled by FrameUniforms (include/Shader.h)
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPos;
+};
+
 uniform vec3 objectColor;
 uniform vec3 lightColor;
 uniform vec3 lightPos;
-uniform vec3 viewPos;
 
 void main()
 {
@@ -23,7 +29,7 @@ void main()
 
     // Specular
     float specularStrength = 0.8;
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(cameraPos.xyz - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
     vec3 specular = specularStrength * spec * lightColor;
@@ -0,0 +1,513 @@
+#include "AdaptiveGrid.h"
+#include "PotentialField.h"
+#include <algorithm>
+#include <cmath>
+
+const uint32_t NO_SLOT = UINT32_MAX;
+const int32_t FREE_NODE = -2;
+// a balanced leaf draws its lower and left edges (and its upper and right ones on
+// the rim) in at most two pieces each
+const unsigned int LINES_PER_LEAF = 8;
+// settled once no vertex is further than this from its target
+const float LOD_SETTLE_EPSILON = 1e-4f;
+// incremental re-targets between full ones, which wash out the rounding the
+// added and removed pulls leave behind
+const unsigned int LOD_RESYNC_UPDATES = 1024;
+
+AdaptiveGrid::AdaptiveGrid(float extent, unsigned int minDepth, unsigned int maxDepth)
+    : Tolerance(0.02f), extent(extent), minDepth(std::min(minDepth, maxDepth)), maxDepth(std::min(maxDepth, 15u)),
+      softening(0.0f), scale(0.0f), leafCount(0), fitted(nullptr), fittedVersion(0), incrementalUpdates(0),
+      layered(false), settled(true)
+{
+    this->resolution = 1u << this->maxDepth;
+    const unsigned int side = this->resolution + 1;
+    this->slots.assign(side * side, NO_SLOT);
+    this->corners.assign(side * side, 0);
+    this->potential.assign(side * side, 0.0f);
+    this->shown.assign(side * side, 0.0f);
+    this->target.assign(side * side, 0.0f);
+    this->depthMap.assign(this->resolution * this->resolution, 0);
+
+    this->nodes.push_back(Node{ 0, 0, 0, -1 });
+    this->lineAt.resize(LINES_PER_LEAF);
+    this->lineCount.resize(1);
+    this->queued.resize(1);
+    this->addLeaf(0);
+    this->refit(0, nullptr);
+    this->balance();
+    this->commit();
+    this->appeared.clear();
+}
+
+bool AdaptiveGrid::wantsSplit(const Node& node) const
+{
+    if (node.Depth < this->minDepth) return true;
+    if (node.Depth >= this->maxDepth) return false;
+
+    // |d^2/dr^2| of gm / sqrt(r^2 + eps^2) stays below 2 gm / (r^2 + eps^2)^(3/2),
+    // taken at the cell's nearest point to each body
+    const float size = this->nodeSize(node);
+    const float fine = this->extent / this->resolution;
+    const float x0 = -0.5f * this->extent + node.Col * fine;
+    const float z0 = -0.5f * this->extent + node.Row * fine;
+    const float eps2 = this->softening * this->softening;
+    const float limit = this->Tolerance * 8.0f / (this->scale * size * size);
+    float curvature = 0.0f;
+    for (size_t b = 0; b < this->appliedGM.size(); ++b)
+    {
+        float dx = std::max({ x0 - this->appliedX[b], this->appliedX[b] - (x0 + size), 0.0f });
+        float dz = std::max({ z0 - this->appliedZ[b], this->appliedZ[b] - (z0 + size), 0.0f });
+        float r2 = dx * dx + dz * dz + eps2;
+        curvature += 2.0f * this->appliedGM[b] / (r2 * std::sqrt(r2));
+        if (curvature > limit) return true;
+    }
+    return false;
+}
+
+// whether a moved body comes close enough to the cell to change its split on its own
+bool AdaptiveGrid::reaches(const Node& node, const std::vector<Reach>& moved) const
+{
+    const float size = this->nodeSize(node);
+    const float fine = this->extent / this->resolution;
+    const float x0 = -0.5f * this->extent + node.Col * fine;
+    const float z0 = -0.5f * this->extent + node.Row * fine;
+    for (const Reach& reach : moved)
+    {
+        const float r = reach.Radius[node.Depth];
+        if (x0 <= reach.MaxX + r && x0 + size >= reach.MinX - r && z0 <= reach.MaxZ + r && z0 + size >= reach.MinZ - r)
+            return true;
+    }
+    return false;
+}
+
+// moved null refits every cell
+void AdaptiveGrid::refit(int32_t index, const std::vector<Reach>* moved)
+{
+    if (moved && this->nodes[index].Depth >= this->minDepth && !this->reaches(this->nodes[index], *moved))
+        return;
+
+    const bool want = this->wantsSplit(this->nodes[index]);
+    if (this->nodes[index].Children < 0) {
+        if (!want) return;
+        this->split(index);
+    } else if (!want) {
+        this->merge(index);
+        return;
+    }
+    const int32_t first = this->nodes[index].Children;
+    for (int32_t c = 0; c < 4; ++c)
+        this->refit(first + c, moved);
+}
+
+void AdaptiveGrid::split(int32_t index)
+{
+    int32_t first;
+    if (!this->freeBlocks.empty()) {
+        first = this->freeBlocks.back();
+        this->freeBlocks.pop_back();
+    } else {
+        first = (int32_t)this->nodes.size();
+        this->nodes.resize(this->nodes.size() + 4);
+        this->lineAt.resize(this->nodes.size() * LINES_PER_LEAF);
+        this->lineCount.resize(this->nodes.size(), 0);
+        this->queued.resize(this->nodes.size(), 0);
+    }
+    const Node node = this->nodes[index];
+    const uint16_t half = (uint16_t)((this->resolution >> node.Depth) / 2);
+    const uint8_t depth = node.Depth + 1;
+
+    // vertices that were not drawn before start on the flat cell they split
+    const unsigned int side = this->resolution + 1;
+    const unsigned int i0 = node.Col, j0 = node.Row, i1 = node.Col + 2 * half, j1 = node.Row + 2 * half;
+    const unsigned int im = node.Col + half, jm = node.Row + half;
+    const float a = this->shown[j0 * side + i0], b = this->shown[j0 * side + i1];
+    const float c = this->shown[j1 * side + i0], d = this->shown[j1 * side + i1];
+    const unsigned int fresh[5] = { j0 * side + im, jm * side + i0, jm * side + i1, j1 * side + im, jm * side + im };
+    const float start[5] = { 0.5f * (a + b), 0.5f * (a + c), 0.5f * (b + d), 0.5f * (c + d), 0.25f * (a + b + c + d) };
+    for (unsigned int v = 0; v < 5; ++v)
+        if (this->slots[fresh[v]] == NO_SLOT) {
+            this->shown[fresh[v]] = start[v];
+            this->target[fresh[v]] = start[v];
+        }
+
+    this->removeLeaf(index);
+    this->nodes[first + 0] = Node{ node.Col, node.Row, depth, -1 };
+    this->nodes[first + 1] = Node{ (uint16_t)(node.Col + half), node.Row, depth, -1 };
+    this->nodes[first + 2] = Node{ node.Col, (uint16_t)(node.Row + half), depth, -1 };
+    this->nodes[first + 3] = Node{ (uint16_t)(node.Col + half), (uint16_t)(node.Row + half), depth, -1 };
+    this->nodes[index].Children = first;
+    for (int32_t c = 0; c < 4; ++c)
+        this->addLeaf(first + c);
+}
+
+void AdaptiveGrid::merge(int32_t index)
+{
+    this->release(index);
+    this->addLeaf(index);
+}
+
+// drops everything under the node, leaving it childless but not yet a leaf
+void AdaptiveGrid::release(int32_t index)
+{
+    const int32_t first = this->nodes[index].Children;
+    for (int32_t c = 0; c < 4; ++c) {
+        if (this->nodes[first + c].Children >= 0) this->release(first + c);
+        else this->removeLeaf(first + c);
+        this->nodes[first + c].Children = FREE_NODE;
+    }
+    this->freeBlocks.push_back(first);
+    this->nodes[index].Children = -1;
+}
+
+// a vertex appears with its first leaf; one whose last leaf went is only dropped
+// in commit, so a cell merged and split again in the same update keeps its slots
+void AdaptiveGrid::addLeaf(int32_t index)
+{
+    const Node& node = this->nodes[index];
+    const unsigned int res = this->resolution;
+    const unsigned int side = res + 1;
+    const unsigned int k = res >> node.Depth;
+    for (unsigned int j = node.Row; j < node.Row + k; ++j)
+        std::fill_n(&this->depthMap[j * res + node.Col], k, node.Depth);
+
+    const float fine = this->extent / res;
+    const unsigned int cornerKeys[4] = { node.Row * side + node.Col, node.Row * side + node.Col + k,
+                                         (node.Row + k) * side + node.Col, (node.Row + k) * side + node.Col + k };
+    for (unsigned int key : cornerKeys) {
+        if (this->corners[key]++ > 0 || this->slots[key] != NO_SLOT)
+            continue;
+        uint32_t slot;
+        if (!this->freeSlots.empty()) {
+            slot = this->freeSlots.back();
+            this->freeSlots.pop_back();
+        } else {
+            slot = (uint32_t)this->keys.size();
+            this->keys.push_back(NO_SLOT);
+            this->vertices.resize(this->vertices.size() + 3);
+            this->pointX.push_back(0.0f);
+            this->pointZ.push_back(0.0f);
+        }
+        this->keys[slot] = key;
+        this->slots[key] = slot;
+        this->pointX[slot] = -0.5f * this->extent + (key % side) * fine;
+        this->pointZ[slot] = -0.5f * this->extent + (key / side) * fine;
+        this->vertices[slot * 3 + 0] = this->pointX[slot];
+        this->vertices[slot * 3 + 1] = this->shown[key];
+        this->vertices[slot * 3 + 2] = this->pointZ[slot];
+        this->appeared.push_back(key);
+        this->touched.push_back(key);
+    }
+    ++this->leafCount;
+    this->added.push_back(index);
+    this->queue(index);
+}
+
+void AdaptiveGrid::removeLeaf(int32_t index)
+{
+    const Node& node = this->nodes[index];
+    const unsigned int side = this->resolution + 1;
+    const unsigned int k = this->resolution >> node.Depth;
+    const unsigned int cornerKeys[4] = { node.Row * side + node.Col, node.Row * side + node.Col + k,
+                                         (node.Row + k) * side + node.Col, (node.Row + k) * side + node.Col + k };
+    for (unsigned int key : cornerKeys)
+        if (--this->corners[key] == 0)
+            this->vanished.push_back(key);
+    --this->leafCount;
+    this->queue(index);
+}
+
+// the leaf holding finest cell (col, row)
+int32_t AdaptiveGrid::findLeaf(unsigned int col, unsigned int row) const
+{
+    int32_t index = 0;
+    while (this->nodes[index].Children >= 0) {
+        const Node& node = this->nodes[index];
+        const unsigned int half = (this->resolution >> node.Depth) / 2;
+        index = node.Children + (col >= node.Col + half ? 1 : 0) + (row >= node.Row + half ? 2 : 0);
+    }
+    return index;
+}
+
+void AdaptiveGrid::queue(int32_t index)
+{
+    if (this->queued[index]) return;
+    this->queued[index] = 1;
+    this->emitQueue.push_back(index);
+}
+
+// splits leaves until no two neighbours are more than one level apart. only a
+// leaf added this update can be out of balance, with a neighbour on either side
+void AdaptiveGrid::balance()
+{
+    const unsigned int res = this->resolution;
+    while (!this->added.empty())
+    {
+        const int32_t index = this->added.back();
+        this->added.pop_back();
+        if (this->nodes[index].Children != -1)
+            continue;
+        const Node node = this->nodes[index];
+        const unsigned int k = res >> node.Depth;
+        const unsigned int col = node.Col, row = node.Row;
+        const bool present[4] = { col > 0, col + k < res, row > 0, row + k < res };
+        bool coarse = false;
+        for (unsigned int t = 0; t < k && !coarse; ++t) {
+            // the cells beside the left, right, lower and upper edges
+            const unsigned int beside[4][2] = { { col - 1, row + t }, { col + k, row + t }, { col + t, row - 1 }, { col + t, row + k } };
+            for (unsigned int s = 0; s < 4; ++s) {
+                if (!present[s]) continue;
+                const uint8_t depth = this->depthMap[beside[s][1] * res + beside[s][0]];
+                if (depth > node.Depth + 1) {
+                    coarse = true;
+                    break;
+                }
+                if (depth + 1 < node.Depth)
+                    this->split(this->findLeaf(beside[s][0], beside[s][1]));
+            }
+        }
+        if (coarse)
+            this->split(index);
+    }
+}
+
+// drops the vertices no leaf uses any more and redraws the lines of the leaves
+// that changed and of their neighbours, whose edges may have gained or lost a
+// vertex. true when the vertex or line lists changed
+bool AdaptiveGrid::commit()
+{
+    const unsigned int res = this->resolution;
+    const unsigned int side = res + 1;
+    bool changed = false;
+    for (uint32_t key : this->vanished) {
+        if (this->corners[key] > 0 || this->slots[key] == NO_SLOT)
+            continue;
+        this->keys[this->slots[key]] = NO_SLOT;
+        this->freeSlots.push_back(this->slots[key]);
+        this->slots[key] = NO_SLOT;
+        this->touched.push_back(key);
+        changed = true;
+    }
+    this->vanished.clear();
+    changed |= !this->appeared.empty();
+
+    for (uint32_t key : this->touched) {
+        const unsigned int i = key % side, j = key / side;
+        for (unsigned int dj = 0; dj < 2; ++dj)
+            for (unsigned int di = 0; di < 2; ++di)
+                if (i + di >= 1 && i + di <= res && j + dj >= 1 && j + dj <= res)
+                    this->queue(this->findLeaf(i + di - 1, j + dj - 1));
+    }
+    this->touched.clear();
+
+    for (int32_t index : this->emitQueue) {
+        this->queued[index] = 0;
+        changed |= this->emitLines(index);
+    }
+    this->emitQueue.clear();
+    return changed;
+}
+
+// redraws one node's pieces, a leaf's edges or nothing for a node that is no
+// longer a leaf; false when they came out as they were
+bool AdaptiveGrid::emitLines(int32_t index)
+{
+    this->pieces.clear();
+    const Node& node = this->nodes[index];
+    if (node.Children == -1) {
+        const unsigned int res = this->resolution;
+        const unsigned int k = res >> node.Depth;
+        this->emitEdge(node.Col, node.Row, node.Col + k, node.Row);
+        this->emitEdge(node.Col, node.Row, node.Col, node.Row + k);
+        if (node.Row + k == res) this->emitEdge(node.Col, node.Row + k, node.Col + k, node.Row + k);
+        if (node.Col + k == res) this->emitEdge(node.Col + k, node.Row, node.Col + k, node.Row + k);
+    }
+
+    const unsigned int count = (unsigned int)this->pieces.size() / 2;
+    bool same = count == this->lineCount[index];
+    for (unsigned int p = 0; p < count && same; ++p) {
+        const uint32_t at = this->lineAt[index * LINES_PER_LEAF + p];
+        same = this->lines[at * 2] == this->pieces[p * 2] && this->lines[at * 2 + 1] == this->pieces[p * 2 + 1];
+    }
+    if (same)
+        return false;
+
+    this->releaseLines(index);
+    for (unsigned int p = 0; p < count; ++p) {
+        this->lineAt[index * LINES_PER_LEAF + p] = (uint32_t)this->lineOwner.size();
+        this->lineOwner.push_back(index * LINES_PER_LEAF + p);
+        this->lines.push_back(this->pieces[p * 2]);
+        this->lines.push_back(this->pieces[p * 2 + 1]);
+    }
+    this->lineCount[index] = (uint8_t)count;
+    return true;
+}
+
+// the last pair moves into each freed spot, so order is not kept
+void AdaptiveGrid::releaseLines(int32_t index)
+{
+    for (unsigned int p = 0; p < this->lineCount[index]; ++p) {
+        const uint32_t at = this->lineAt[index * LINES_PER_LEAF + p];
+        const uint32_t last = (uint32_t)this->lineOwner.size() - 1;
+        const uint32_t owner = this->lineOwner[last];
+        this->lines[at * 2] = this->lines[last * 2];
+        this->lines[at * 2 + 1] = this->lines[last * 2 + 1];
+        this->lineOwner[at] = owner;
+        this->lineAt[owner] = at;
+        this->lines.resize(last * 2);
+        this->lineOwner.pop_back();
+    }
+    this->lineCount[index] = 0;
+}
+
+// a coarse edge is drawn in pieces through the vertices finer neighbours placed on it
+void AdaptiveGrid::emitEdge(unsigned int i0, unsigned int j0, unsigned int i1, unsigned int j1)
+{
+    const unsigned int side = this->resolution + 1;
+    const unsigned int length = (i1 - i0) + (j1 - j0);
+    if (length > 1) {
+        const unsigned int im = (i0 + i1) / 2, jm = (j0 + j1) / 2;
+        if (this->slots[jm * side + im] != NO_SLOT) {
+            this->emitEdge(i0, j0, im, jm);
+            this->emitEdge(im, jm, i1, j1);
+            return;
+        }
+    }
+    this->pieces.push_back(this->slots[j0 * side + i0]);
+    this->pieces.push_back(this->slots[j1 * side + i1]);
+}
+
+// incremental adds the moved bodies' change in pull to every vertex and
+// evaluates only the vertices that appeared against all the bodies
+void AdaptiveGrid::retarget(bool incremental)
+{
+    const size_t count = this->keys.size();
+    this->pointHeights.resize(count);
+    if (!incremental) {
+        PotentialField::EvaluatePoints(this->pointX.data(), this->pointZ.data(), (unsigned int)count,
+                                       this->appliedX.data(), this->appliedZ.data(), this->appliedGM.data(),
+                                       (unsigned int)this->appliedGM.size(), this->softening, this->scale, this->pointHeights.data());
+        for (size_t v = 0; v < count; ++v)
+            if (this->keys[v] != NO_SLOT)
+                this->potential[this->keys[v]] = this->pointHeights[v];
+        this->appeared.clear();
+        return;
+    }
+
+    PotentialField::EvaluatePoints(this->pointX.data(), this->pointZ.data(), (unsigned int)count,
+                                   this->deltaX.data(), this->deltaZ.data(), this->deltaGM.data(),
+                                   (unsigned int)this->deltaGM.size(), this->softening, this->scale, this->pointHeights.data());
+    for (size_t v = 0; v < count; ++v)
+        if (this->keys[v] != NO_SLOT)
+            this->potential[this->keys[v]] += this->pointHeights[v];
+
+    this->freshX.clear();
+    this->freshZ.clear();
+    for (uint32_t& key : this->appeared) {
+        if (this->slots[key] == NO_SLOT) continue;
+        this->freshX.push_back(this->pointX[this->slots[key]]);
+        this->freshZ.push_back(this->pointZ[this->slots[key]]);
+        this->appeared[this->freshX.size() - 1] = key;
+    }
+    const size_t fresh = this->freshX.size();
+    this->freshHeights.resize(fresh);
+    PotentialField::EvaluatePoints(this->freshX.data(), this->freshZ.data(), (unsigned int)fresh,
+                                   this->appliedX.data(), this->appliedZ.data(), this->appliedGM.data(),
+                                   (unsigned int)this->appliedGM.size(), this->softening, this->scale, this->freshHeights.data());
+    for (size_t v = 0; v < fresh; ++v)
+        this->potential[this->appeared[v]] = this->freshHeights[v];
+    this->appeared.clear();
+}
+
+bool AdaptiveGrid::Update(const BodyRegistry& bodies, float softening, float scale, const HeightField* layer)
+{
+    const bool sameSetup = this->fitted == &bodies && this->softening == softening && this->scale == scale;
+    bool refitted = false, changed = false;
+    if (!sameSetup || this->fittedVersion != bodies.Version()) {
+        const bool full = !sameSetup || this->appliedGM.size() != bodies.Count;
+        std::vector<Reach> moved;
+        this->deltaX.clear();
+        this->deltaZ.clear();
+        this->deltaGM.clear();
+        if (!full) {
+            for (unsigned int b = 0; b < bodies.Count; ++b) {
+                if (bodies.PosX[b] == this->appliedX[b] && bodies.PosZ[b] == this->appliedZ[b] && bodies.GM[b] == this->appliedGM[b])
+                    continue;
+                Reach reach{ std::min(bodies.PosX[b], this->appliedX[b]), std::min(bodies.PosZ[b], this->appliedZ[b]),
+                             std::max(bodies.PosX[b], this->appliedX[b]), std::max(bodies.PosZ[b], this->appliedZ[b]), {} };
+                // the distance at which a cell of that depth stops wanting to split
+                const float gm = std::max(bodies.GM[b], this->appliedGM[b]);
+                for (unsigned int depth = 0; depth <= this->maxDepth; ++depth) {
+                    const float size = this->extent / (float)(1u << depth);
+                    float r2 = std::pow(scale * size * size * gm / (4.0f * this->Tolerance), 2.0f / 3.0f) - softening * softening;
+                    reach.Radius[depth] = std::sqrt(std::max(r2, 0.0f));
+                }
+                moved.push_back(reach);
+                // its old pull comes out, its new one goes in
+                this->deltaX.push_back(this->appliedX[b]);
+                this->deltaZ.push_back(this->appliedZ[b]);
+                this->deltaGM.push_back(-this->appliedGM[b]);
+                this->deltaX.push_back(bodies.PosX[b]);
+                this->deltaZ.push_back(bodies.PosZ[b]);
+                this->deltaGM.push_back(bodies.GM[b]);
+            }
+        }
+        this->fitted = &bodies;
+        this->fittedVersion = bodies.Version();
+
+        if (full || !moved.empty()) {
+            this->softening = softening;
+            this->scale = scale;
+            this->appliedX.assign(bodies.PosX.data(), bodies.PosX.data() + bodies.Count);
+            this->appliedZ.assign(bodies.PosZ.data(), bodies.PosZ.data() + bodies.Count);
+            this->appliedGM.assign(bodies.GM.data(), bodies.GM.data() + bodies.Count);
+
+            this->refit(0, full ? nullptr : &moved);
+            this->balance();
+            changed = this->commit();
+            // the change in pull costs two bodies per moved one against all of them
+            const bool incremental = !full && this->deltaGM.size() < bodies.Count && this->incrementalUpdates < LOD_RESYNC_UPDATES;
+            this->incrementalUpdates = incremental ? this->incrementalUpdates + 1 : 0;
+            this->retarget(incremental);
+            refitted = true;
+        }
+    }
+    if (!refitted && !layer && !this->layered)
+        return false;
+
+    float height, gradX, gradZ;
+    for (size_t v = 0; v < this->keys.size(); ++v) {
+        const uint32_t key = this->keys[v];
+        if (key == NO_SLOT) continue;
+        this->target[key] = this->potential[key];
+        if (layer && layer->Sample(this->pointX[v], this->pointZ[v], height, gradX, gradZ))
+            this->target[key] += height;
+    }
+    this->layered = layer != nullptr;
+    this->settled = false;
+    return changed;
+}
+
+bool AdaptiveGrid::Ease(float factor)
+{
+    if (this->settled)
+        return false;
+
+    float furthest = 0.0f;
+    for (size_t v = 0; v < this->keys.size(); ++v) {
+        const uint32_t key = this->keys[v];
+        if (key == NO_SLOT) continue;
+        furthest = std::max(furthest, std::fabs(this->target[key] - this->shown[key]));
+        this->shown[key] += (this->target[key] - this->shown[key]) * factor;
+        this->vertices[v * 3 + 1] = this->shown[key];
+    }
+    if (furthest < LOD_SETTLE_EPSILON) {
+        for (size_t v = 0; v < this->keys.size(); ++v) {
+            const uint32_t key = this->keys[v];
+            if (key == NO_SLOT) continue;
+            this->shown[key] = this->target[key];
+            this->vertices[v * 3 + 1] = this->shown[key];
+        }
+        this->settled = true;
+    }
+    return true;
+}
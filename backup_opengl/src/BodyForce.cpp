@@ -0,0 +1,131 @@
+#include "BodyForce.h"
+#include <cmath>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BODY_FORCE_X86 1
+#include <immintrin.h>
+#endif
+
+static void accumulateScalar(const float* x, const float* y, const float* z, unsigned int begin, unsigned int end,
+                             const float* bodyX, const float* bodyY, const float* bodyZ, const float* bodyGM,
+                             unsigned int bodyCount, float eps2, float* ax, float* ay, float* az)
+{
+    for (unsigned int i = begin; i < end; ++i)
+    {
+        float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+        for (unsigned int b = 0; b < bodyCount; ++b)
+        {
+            float dx = bodyX[b] - x[i];
+            float dy = bodyY[b] - y[i];
+            float dz = bodyZ[b] - z[i];
+            float inv = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+            float s = bodyGM[b] * inv * inv * inv;
+            sx += dx * s;
+            sy += dy * s;
+            sz += dz * s;
+        }
+        ax[i] += sx;
+        ay[i] += sy;
+        az[i] += sz;
+    }
+}
+
+#ifdef BODY_FORCE_X86
+
+// same refinement as PotentialField: rsqrt plus one Newton step, ~23 bits
+
+__attribute__((target("sse2")))
+static unsigned int accumulateSSE(const float* x, const float* y, const float* z, unsigned int count,
+                                  const float* bodyX, const float* bodyY, const float* bodyZ, const float* bodyGM,
+                                  unsigned int bodyCount, float eps2, float* ax, float* ay, float* az)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    const __m128 vEps2 = _mm_set1_ps(eps2);
+
+    unsigned int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pz = _mm_loadu_ps(z + i);
+        __m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps(), sz = _mm_setzero_ps();
+        for (unsigned int b = 0; b < bodyCount; ++b)
+        {
+            __m128 dx = _mm_sub_ps(_mm_set1_ps(bodyX[b]), px);
+            __m128 dy = _mm_sub_ps(_mm_set1_ps(bodyY[b]), py);
+            __m128 dz = _mm_sub_ps(_mm_set1_ps(bodyZ[b]), pz);
+            __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_add_ps(_mm_mul_ps(dz, dz), vEps2));
+            __m128 inv = _mm_rsqrt_ps(r2);
+            inv = _mm_mul_ps(inv, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(inv, inv))));
+            __m128 s = _mm_mul_ps(_mm_set1_ps(bodyGM[b]), _mm_mul_ps(inv, _mm_mul_ps(inv, inv)));
+            sx = _mm_add_ps(sx, _mm_mul_ps(dx, s));
+            sy = _mm_add_ps(sy, _mm_mul_ps(dy, s));
+            sz = _mm_add_ps(sz, _mm_mul_ps(dz, s));
+        }
+        _mm_storeu_ps(ax + i, _mm_add_ps(_mm_loadu_ps(ax + i), sx));
+        _mm_storeu_ps(ay + i, _mm_add_ps(_mm_loadu_ps(ay + i), sy));
+        _mm_storeu_ps(az + i, _mm_add_ps(_mm_loadu_ps(az + i), sz));
+    }
+    return i;
+}
+
+__attribute__((target("avx2,fma")))
+static unsigned int accumulateAVX2(const float* x, const float* y, const float* z, unsigned int count,
+                                   const float* bodyX, const float* bodyY, const float* bodyZ, const float* bodyGM,
+                                   unsigned int bodyCount, float eps2, float* ax, float* ay, float* az)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 vEps2 = _mm256_set1_ps(eps2);
+
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 pz = _mm256_loadu_ps(z + i);
+        __m256 sx = _mm256_setzero_ps(), sy = _mm256_setzero_ps(), sz = _mm256_setzero_ps();
+        for (unsigned int b = 0; b < bodyCount; ++b)
+        {
+            __m256 dx = _mm256_sub_ps(_mm256_set1_ps(bodyX[b]), px);
+            __m256 dy = _mm256_sub_ps(_mm256_set1_ps(bodyY[b]), py);
+            __m256 dz = _mm256_sub_ps(_mm256_set1_ps(bodyZ[b]), pz);
+            __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_fmadd_ps(dz, dz, vEps2)));
+            __m256 inv = _mm256_rsqrt_ps(r2);
+            inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(inv, inv), threeHalves));
+            __m256 s = _mm256_mul_ps(_mm256_set1_ps(bodyGM[b]), _mm256_mul_ps(inv, _mm256_mul_ps(inv, inv)));
+            sx = _mm256_fmadd_ps(dx, s, sx);
+            sy = _mm256_fmadd_ps(dy, s, sy);
+            sz = _mm256_fmadd_ps(dz, s, sz);
+        }
+        _mm256_storeu_ps(ax + i, _mm256_add_ps(_mm256_loadu_ps(ax + i), sx));
+        _mm256_storeu_ps(ay + i, _mm256_add_ps(_mm256_loadu_ps(ay + i), sy));
+        _mm256_storeu_ps(az + i, _mm256_add_ps(_mm256_loadu_ps(az + i), sz));
+    }
+    return i;
+}
+
+#endif
+
+void accumulateBodyAcceleration(const float* x, const float* y, const float* z, unsigned int count,
+                                const float* bodyX, const float* bodyY, const float* bodyZ, const float* bodyGM,
+                                unsigned int bodyCount, float softening, float* ax, float* ay, float* az)
+{
+    const float eps2 = softening * softening;
+
+    unsigned int done = 0;
+#ifdef BODY_FORCE_X86
+    switch (DetectSimdLevel()) {
+    case SimdLevel::AVX2:
+        done = accumulateAVX2(x, y, z, count, bodyX, bodyY, bodyZ, bodyGM, bodyCount, eps2, ax, ay, az);
+        break;
+    case SimdLevel::SSE:
+        done = accumulateSSE(x, y, z, count, bodyX, bodyY, bodyZ, bodyGM, bodyCount, eps2, ax, ay, az);
+        break;
+    default:
+        break;
+    }
+#endif
+    accumulateScalar(x, y, z, done, count, bodyX, bodyY, bodyZ, bodyGM, bodyCount, eps2, ax, ay, az);
+}
@@ -0,0 +1,178 @@
+#include "BodyRegistry.h"
+#include "BodyForce.h"
+#include "ThreadPool.h"
+#include <cmath>
+
+// bodies per task handed to the thread pool
+const unsigned int BODY_GRAIN = 128;
+
+BodyRegistry::BodyRegistry()
+    : Count(0), version(0)
+{
+}
+
+BodyHandle BodyRegistry::Add(float x, float y, float z, float gm, float vx, float vy, float vz, bool pinned)
+{
+    uint32_t slot;
+    if (!this->freeSlots.empty()) {
+        slot = this->freeSlots.back();
+        this->freeSlots.pop_back();
+    } else {
+        slot = (uint32_t)this->slotIndex.size();
+        this->slotIndex.push_back(UINT32_MAX);
+        this->generation.push_back(0);
+    }
+
+    const unsigned int index = this->Count++;
+    this->slotIndex[slot] = index;
+    this->indexSlot.push_back(slot);
+    this->PosX.push_back(x); this->PosY.push_back(y); this->PosZ.push_back(z);
+    this->VelX.push_back(vx); this->VelY.push_back(vy); this->VelZ.push_back(vz);
+    this->GM.push_back(gm);
+    this->Pinned.push_back(pinned ? 1 : 0);
+    this->version++;
+    return BodyHandle{ slot, this->generation[slot] };
+}
+
+bool BodyRegistry::Remove(BodyHandle handle)
+{
+    const unsigned int index = this->Index(handle);
+    if (index == UINT32_MAX) return false;
+
+    const unsigned int last = this->Count - 1;
+    if (index != last) {
+        this->PosX[index] = this->PosX[last]; this->PosY[index] = this->PosY[last]; this->PosZ[index] = this->PosZ[last];
+        this->VelX[index] = this->VelX[last]; this->VelY[index] = this->VelY[last]; this->VelZ[index] = this->VelZ[last];
+        this->GM[index] = this->GM[last];
+        this->Pinned[index] = this->Pinned[last];
+        this->indexSlot[index] = this->indexSlot[last];
+        this->slotIndex[this->indexSlot[index]] = index;
+    }
+    this->PosX.pop_back(); this->PosY.pop_back(); this->PosZ.pop_back();
+    this->VelX.pop_back(); this->VelY.pop_back(); this->VelZ.pop_back();
+    this->GM.pop_back();
+    this->Pinned.pop_back();
+    this->indexSlot.pop_back();
+    this->Count--;
+
+    this->slotIndex[handle.Slot] = UINT32_MAX;
+    this->generation[handle.Slot]++;
+    this->freeSlots.push_back(handle.Slot);
+    this->version++;
+    return true;
+}
+
+void BodyRegistry::Clear()
+{
+    for (unsigned int index = 0; index < this->Count; ++index) {
+        uint32_t slot = this->indexSlot[index];
+        this->slotIndex[slot] = UINT32_MAX;
+        this->generation[slot]++;
+        this->freeSlots.push_back(slot);
+    }
+    for (AlignedFloatArray* array : { &this->PosX, &this->PosY, &this->PosZ, &this->VelX, &this->VelY, &this->VelZ, &this->GM })
+        array->clear();
+    this->Pinned.clear();
+    this->indexSlot.clear();
+    this->Count = 0;
+    this->version++;
+}
+
+void BodyRegistry::Reserve(unsigned int count)
+{
+    for (AlignedFloatArray* array : { &this->PosX, &this->PosY, &this->PosZ, &this->VelX, &this->VelY, &this->VelZ, &this->GM })
+        array->reserve(count);
+    this->Pinned.reserve(count);
+    this->indexSlot.reserve(count);
+}
+
+bool BodyRegistry::Valid(BodyHandle handle) const
+{
+    return this->Index(handle) != UINT32_MAX;
+}
+
+unsigned int BodyRegistry::Index(BodyHandle handle) const
+{
+    if (handle.Slot >= this->slotIndex.size() || this->generation[handle.Slot] != handle.Generation)
+        return UINT32_MAX;
+    return this->slotIndex[handle.Slot];
+}
+
+void BodyRegistry::Set(BodyHandle handle, float x, float y, float z, float gm)
+{
+    const unsigned int index = this->Index(handle);
+    if (index == UINT32_MAX) return;
+    if (this->PosX[index] == x && this->PosY[index] == y && this->PosZ[index] == z && this->GM[index] == gm)
+        return;
+    this->PosX[index] = x;
+    this->PosY[index] = y;
+    this->PosZ[index] = z;
+    this->GM[index] = gm;
+    this->version++;
+}
+
+// a body's own term vanishes in the kernel (zero offset), so every body can be
+// pulled by the whole set, itself included
+void BodyRegistry::Step(float dt, float softening, ThreadPool* pool)
+{
+    const unsigned int count = this->Count;
+    if (count == 0 || dt <= 0.0f) return;
+
+    bool anyFree = false;
+    for (unsigned int b = 0; b < count && !anyFree; ++b)
+        anyFree = !this->Pinned[b];
+    if (!anyFree) return;
+
+    const float half = 0.5f * dt;
+    for (unsigned int b = 0; b < count; ++b) {
+        if (this->Pinned[b]) continue;
+        this->PosX[b] += this->VelX[b] * half;
+        this->PosY[b] += this->VelY[b] * half;
+        this->PosZ[b] += this->VelZ[b] * half;
+    }
+
+    this->accelX.assign(count, 0.0f);
+    this->accelY.assign(count, 0.0f);
+    this->accelZ.assign(count, 0.0f);
+    auto pull = [&](unsigned int begin, unsigned int end)
+    {
+        accumulateBodyAcceleration(this->PosX.data() + begin, this->PosY.data() + begin, this->PosZ.data() + begin, end - begin,
+                                   this->PosX.data(), this->PosY.data(), this->PosZ.data(), this->GM.data(), count,
+                                   softening, this->accelX.data() + begin, this->accelY.data() + begin, this->accelZ.data() + begin);
+    };
+    if (pool)
+        pool->ParallelFor(0, count, BODY_GRAIN, pull);
+    else
+        pull(0, count);
+
+    for (unsigned int b = 0; b < count; ++b) {
+        if (this->Pinned[b]) continue;
+        this->VelX[b] += this->accelX[b] * dt;
+        this->VelY[b] += this->accelY[b] * dt;
+        this->VelZ[b] += this->accelZ[b] * dt;
+        this->PosX[b] += this->VelX[b] * half;
+        this->PosY[b] += this->VelY[b] * half;
+        this->PosZ[b] += this->VelZ[b] * half;
+    }
+    this->version++;
+}
+
+double BodyRegistry::Energy(float softening) const
+{
+    const double eps2 = (double)softening * softening;
+    double kinetic = 0.0, potential = 0.0;
+    for (unsigned int i = 0; i < this->Count; ++i)
+    {
+        if (!this->Pinned[i])
+            kinetic += 0.5 * this->GM[i] * ((double)this->VelX[i] * this->VelX[i] + (double)this->VelY[i] * this->VelY[i] +
+                                            (double)this->VelZ[i] * this->VelZ[i]);
+        for (unsigned int j = i + 1; j < this->Count; ++j)
+        {
+            double dx = (double)this->PosX[j] - this->PosX[i];
+            double dy = (double)this->PosY[j] - this->PosY[i];
+            double dz = (double)this->PosZ[j] - this->PosZ[i];
+            potential -= (double)this->GM[i] * this->GM[j] / std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+        }
+    }
+    return kinetic + potential;
+}
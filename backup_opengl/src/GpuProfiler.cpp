@@ -0,0 +1,105 @@
+#include "GpuProfiler.h"
+#include "Profiler.h"
+
+// re-read the GPU clock against the CPU's about once a second at 60 fps
+const unsigned int GPU_CALIBRATION_INTERVAL = 60;
+
+GpuProfiler::GpuProfiler()
+    : current(0), supported(false), active(false), clockOffset(0), framesSinceCalibration(0)
+{
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (Frame& frame : this->frames)
+        if (!frame.Queries.empty())
+            glDeleteQueries((GLsizei)frame.Queries.size(), frame.Queries.data());
+}
+
+void GpuProfiler::Init()
+{
+    // timestamps are core since 3.3, the extension covers older drivers
+    this->supported = GLEW_ARB_timer_query || GLEW_VERSION_3_3;
+    if (this->supported)
+        this->calibrate();
+}
+
+void GpuProfiler::calibrate()
+{
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    this->clockOffset = (long long)Profiler::Now() - (long long)gpuNow;
+    this->framesSinceCalibration = 0;
+}
+
+void GpuProfiler::Begin(const char* name)
+{
+    if (!this->supported) return;
+    // a frame either records all its scopes or none, so Begin/End stay paired
+    if (this->open.empty())
+        this->active = Profiler::Enabled();
+    if (!this->active) return;
+
+    Frame& frame = this->frames[this->current];
+    if (frame.Used + 2 > frame.Queries.size()) {
+        size_t oldSize = frame.Queries.size();
+        frame.Queries.resize(oldSize + 16);
+        glGenQueries(16, frame.Queries.data() + oldSize);
+    }
+
+    glQueryCounter(frame.Queries[frame.Used], GL_TIMESTAMP);
+    frame.LastIssued = frame.Queries[frame.Used];
+    this->open.push_back((unsigned int)frame.Scopes.size());
+    frame.Scopes.push_back(Scope{ name, frame.Used, false });
+    frame.Used += 2;
+}
+
+void GpuProfiler::End()
+{
+    if (!this->supported || !this->active || this->open.empty()) return;
+
+    Frame& frame = this->frames[this->current];
+    Scope& scope = frame.Scopes[this->open.back()];
+    this->open.pop_back();
+    glQueryCounter(frame.Queries[scope.Queries + 1], GL_TIMESTAMP);
+    frame.LastIssued = frame.Queries[scope.Queries + 1];
+    scope.Closed = true;
+}
+
+void GpuProfiler::EndFrame()
+{
+    if (!this->supported) return;
+    this->open.clear();
+
+    this->current = (this->current + 1) % GPU_PROFILER_FRAMES;
+    this->collect(this->frames[this->current]);
+
+    if (++this->framesSinceCalibration >= GPU_CALIBRATION_INTERVAL && Profiler::Enabled())
+        this->calibrate();
+}
+
+// the oldest frame in flight; results that are somehow still pending are dropped
+// rather than waited for
+void GpuProfiler::collect(Frame& frame)
+{
+    if (!frame.Scopes.empty())
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(frame.LastIssued, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            for (const Scope& scope : frame.Scopes)
+            {
+                if (!scope.Closed) continue;
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(frame.Queries[scope.Queries], GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(frame.Queries[scope.Queries + 1], GL_QUERY_RESULT, &end);
+                if (end < begin) continue;
+                long long start = (long long)begin + this->clockOffset;
+                Profiler::Record(scope.Name, start > 0 ? (uint64_t)start : 0, end - begin, PROFILER_GPU_TRACK);
+            }
+        }
+    }
+    frame.Scopes.clear();
+    frame.Used = 0;
+}
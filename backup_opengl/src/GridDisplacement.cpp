@@ -0,0 +1,83 @@
+#include "GridDisplacement.h"
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+// std140 layout of the GridBodies block
+struct GridBodyBlock {
+    float Body[MAX_GRID_BODIES][4];   // xyz, gravitational parameter
+    int   BodyCount[4];
+};
+
+GridDisplacement::GridDisplacement()
+    : UBO(0)
+{
+}
+
+GridDisplacement::~GridDisplacement()
+{
+    if (this->UBO != 0)
+        glDeleteBuffers(1, &this->UBO);
+}
+
+void GridDisplacement::Init(const Shader& shader)
+{
+    glGenBuffers(1, &this->UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, this->UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(GridBodyBlock), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, GRID_BODY_BINDING, this->UBO);
+
+    if (!shader.BindBlock("GridBodies", GRID_BODY_BINDING))
+        std::cerr << "ERRO::GRID: bloco GridBodies nao encontrado no shader" << std::endl;
+}
+
+void GridDisplacement::Reset(const BodyRegistry& bodies)
+{
+    if (bodies.Count > MAX_GRID_BODIES) {
+        static bool warned = false;
+        if (!warned)
+            std::cerr << "AVISO::GRID: mais de " << MAX_GRID_BODIES << " corpos, o excedente nao deforma a malha" << std::endl;
+        warned = true;
+    }
+
+    this->drawnBodies.resize(std::min(bodies.Count, MAX_GRID_BODIES));
+    for (size_t b = 0; b < this->drawnBodies.size(); ++b)
+        this->drawnBodies[b] = GravitationalBody{ glm::vec3(bodies.PosX[b], bodies.PosY[b], bodies.PosZ[b]), bodies.GM[b] };
+    this->upload();
+}
+
+void GridDisplacement::Update(const BodyRegistry& bodies, float smoothing)
+{
+    if (this->drawnBodies.size() != std::min(bodies.Count, MAX_GRID_BODIES)) {
+        this->Reset(bodies);
+        return;
+    }
+    for (size_t b = 0; b < this->drawnBodies.size(); ++b) {
+        GravitationalBody& drawn = this->drawnBodies[b];
+        drawn.Position += (glm::vec3(bodies.PosX[b], bodies.PosY[b], bodies.PosZ[b]) - drawn.Position) * smoothing;
+        drawn.GravitationalParameter += (bodies.GM[b] - drawn.GravitationalParameter) * smoothing;
+    }
+    this->upload();
+}
+
+void GridDisplacement::upload()
+{
+    if (this->UBO == 0) return;
+
+    GridBodyBlock block;
+    unsigned int count = (unsigned int)this->drawnBodies.size();
+    for (unsigned int b = 0; b < count; ++b) {
+        block.Body[b][0] = this->drawnBodies[b].Position.x;
+        block.Body[b][1] = this->drawnBodies[b].Position.y;
+        block.Body[b][2] = this->drawnBodies[b].Position.z;
+        block.Body[b][3] = this->drawnBodies[b].GravitationalParameter;
+    }
+    block.BodyCount[0] = (int)count;
+
+    // only the used part of the body array goes over the bus
+    glBindBuffer(GL_UNIFORM_BUFFER, this->UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(block.Body[0]), block.Body);
+    glBufferSubData(GL_UNIFORM_BUFFER, offsetof(GridBodyBlock, BodyCount), sizeof(block.BodyCount), block.BodyCount);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
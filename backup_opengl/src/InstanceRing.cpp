@@ -0,0 +1,137 @@
+#include "InstanceRing.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+static bool persistentMappingAllowed()
+{
+    const char* setting = std::getenv("GRAVITY_GL_PERSISTENT");
+    if (setting != nullptr && std::strcmp(setting, "0") == 0)
+        return false;
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+uint32_t packInstanceColor(float r, float g, float b, float a)
+{
+    auto channel = [](float v) {
+        return (uint32_t)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+    };
+    return channel(r) | (channel(g) << 8) | (channel(b) << 16) | (channel(a) << 24);
+}
+
+InstanceRing::InstanceRing()
+    : vao(0), buffer(0), capacity(0), segment(0), mapped(nullptr)
+{
+    for (unsigned int i = 0; i < RING_SEGMENTS; ++i)
+        this->fences[i] = 0;
+}
+
+InstanceRing::~InstanceRing()
+{
+    this->release();
+}
+
+void InstanceRing::release()
+{
+    for (unsigned int i = 0; i < RING_SEGMENTS; ++i) {
+        this->waitForSegment(i);
+    }
+    if (this->buffer != 0) {
+        if (this->mapped) {
+            glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        glDeleteBuffers(1, &this->buffer);
+    }
+    this->buffer = 0;
+    this->mapped = nullptr;
+    this->capacity = 0;
+}
+
+void InstanceRing::Init(GLuint vao, unsigned int capacity)
+{
+    this->release();
+    this->vao = vao;
+    this->capacity = std::max(capacity, 1u);
+    this->segment = 0;
+
+    glGenBuffers(1, &this->buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+
+    if (persistentMappingAllowed()) {
+        GLsizeiptr bytes = (GLsizeiptr)this->capacity * RING_SEGMENTS * sizeof(ParticleInstance);
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, flags);
+        this->mapped = (ParticleInstance*)glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags);
+    }
+    if (!this->mapped) {
+        // glBufferStorage made the old storage immutable, so start from a fresh name
+        glDeleteBuffers(1, &this->buffer);
+        glGenBuffers(1, &this->buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)this->capacity * sizeof(ParticleInstance), nullptr, GL_STREAM_DRAW);
+        this->staging.resize(this->capacity);
+    }
+
+    glBindVertexArray(this->vao);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceRing::waitForSegment(unsigned int index)
+{
+    GLsync fence = this->fences[index];
+    if (!fence) return;
+
+    // triple buffering makes this a no-op unless the GPU is two frames behind
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+    glDeleteSync(fence);
+    this->fences[index] = 0;
+}
+
+ParticleInstance* InstanceRing::Begin(unsigned int count)
+{
+    if (count > this->capacity)
+        this->Init(this->vao, count + count / 2);
+
+    if (!this->mapped)
+        return this->staging.data();
+
+    this->segment = (this->segment + 1) % RING_SEGMENTS;
+    this->waitForSegment(this->segment);
+    return this->mapped + (size_t)this->segment * this->capacity;
+}
+
+void InstanceRing::Commit(unsigned int count)
+{
+    size_t first = 0;
+    glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+    if (this->mapped) {
+        first = (size_t)this->segment * this->capacity;
+    } else {
+        // orphan, so the driver hands back fresh storage instead of syncing
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)this->capacity * sizeof(ParticleInstance), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)count * sizeof(ParticleInstance), this->staging.data());
+    }
+
+    // the segment moves every frame, so the attributes are re-pointed at it
+    const char* base = (const char*)(first * sizeof(ParticleInstance));
+    glBindVertexArray(this->vao);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (const void*)base);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ParticleInstance), (const void*)(base + offsetof(ParticleInstance, Color)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceRing::Fence()
+{
+    if (!this->mapped) return;
+    this->fences[this->segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,54 @@
+#include "Integrator.h"
+#include <cmath>
+#include <algorithm>
+
+// Yoshida's fourth order weights: w1 = 1 / (2 - 2^(1/3)), w0 = 1 - 2 w1
+const float YOSHIDA_W1 = 1.0f / (2.0f - std::cbrt(2.0f));
+const float YOSHIDA_W0 = 1.0f - 2.0f * YOSHIDA_W1;
+
+const IntegratorStages& integratorStages(Integrator integrator)
+{
+    static const IntegratorStages euler    = { 1, { 0.0f, 1.0f }, { 1.0f } };
+    static const IntegratorStages leapfrog = { 1, { 0.5f, 0.5f }, { 1.0f } };
+    static const IntegratorStages yoshida4 = { 3,
+        { YOSHIDA_W1 * 0.5f, (YOSHIDA_W0 + YOSHIDA_W1) * 0.5f, (YOSHIDA_W0 + YOSHIDA_W1) * 0.5f, YOSHIDA_W1 * 0.5f },
+        { YOSHIDA_W1, YOSHIDA_W0, YOSHIDA_W1 } };
+
+    switch (integrator) {
+        case Integrator::Leapfrog: return leapfrog;
+        case Integrator::Yoshida4: return yoshida4;
+        default:                   return euler;
+    }
+}
+
+const char* integratorName(Integrator integrator)
+{
+    switch (integrator) {
+        case Integrator::Leapfrog: return "leapfrog";
+        case Integrator::Yoshida4: return "yoshida4";
+        default:                   return "euler";
+    }
+}
+
+bool parseIntegrator(const std::string& name, Integrator& integrator)
+{
+    if (name == "euler")         integrator = Integrator::Euler;
+    else if (name == "leapfrog") integrator = Integrator::Leapfrog;
+    else if (name == "yoshida4") integrator = Integrator::Yoshida4;
+    else return false;
+    return true;
+}
+
+unsigned int scheduleSubsteps(float dt, float maxSpeed, float maxAcceleration, float length, const SubstepLimits& limits)
+{
+    float substep = dt;
+    if (maxSpeed > 0.0f)
+        substep = std::min(substep, limits.Courant * length / maxSpeed);
+    if (maxAcceleration > 0.0f)
+        substep = std::min(substep, limits.AccelerationFactor * std::sqrt(length / maxAcceleration));
+    if (!(substep > 0.0f) || !std::isfinite(substep))
+        return std::max(1u, limits.MaxSubsteps);
+
+    float needed = std::ceil(dt / substep);
+    return (unsigned int)std::clamp(needed, 1.0f, (float)std::max(1u, limits.MaxSubsteps));
+}
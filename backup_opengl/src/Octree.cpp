@@ -0,0 +1,165 @@
+#include "Octree.h"
+#include <cmath>
+#include <algorithm>
+
+const unsigned int LEAF_CAPACITY = 8;
+// particles spawn on top of each other, so splitting must stop somewhere
+const unsigned int MAX_DEPTH = 20;
+const unsigned int TRAVERSAL_STACK = 8 * MAX_DEPTH + 8;
+
+Octree::Octree()
+{
+}
+
+void Octree::Build(const float* x, const float* y, const float* z, const float* m, unsigned int count)
+{
+    this->nodes.clear();
+    if (count == 0) {
+        this->posX.clear(); this->posY.clear(); this->posZ.clear(); this->mass.clear();
+        return;
+    }
+
+    glm::vec3 lo(x[0], y[0], z[0]), hi = lo;
+    for (unsigned int i = 1; i < count; ++i) {
+        lo = glm::min(lo, glm::vec3(x[i], y[i], z[i]));
+        hi = glm::max(hi, glm::vec3(x[i], y[i], z[i]));
+    }
+    glm::vec3 extent = hi - lo;
+    float half = 0.5f * std::max(extent.x, std::max(extent.y, extent.z)) * 1.001f + 1e-4f;
+
+    this->order.resize(count);
+    this->scratch.resize(count);
+    for (unsigned int i = 0; i < count; ++i) this->order[i] = i;
+
+    Node root;
+    root.Center = 0.5f * (lo + hi);
+    root.HalfSize = half;
+    root.First = 0;
+    root.Count = count;
+    this->nodes.push_back(root);
+    this->buildNode(0, 0, x, y, z, m);
+
+    // leaves point into these tree-ordered copies
+    this->posX.resize(count); this->posY.resize(count); this->posZ.resize(count); this->mass.resize(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int src = this->order[i];
+        this->posX[i] = x[src]; this->posY[i] = y[src]; this->posZ[i] = z[src]; this->mass[i] = m[src];
+    }
+}
+
+void Octree::buildNode(unsigned int nodeIndex, unsigned int depth, const float* x, const float* y, const float* z, const float* m)
+{
+    Node node = this->nodes[nodeIndex];
+    for (unsigned int c = 0; c < 8; ++c) node.Children[c] = 0;
+
+    node.Leaf = node.Count <= LEAF_CAPACITY || depth >= MAX_DEPTH;
+    if (node.Leaf)
+    {
+        float total = 0.0f;
+        glm::vec3 weighted(0.0f);
+        for (unsigned int k = node.First; k < node.First + node.Count; ++k) {
+            unsigned int i = this->order[k];
+            total += m[i];
+            weighted += m[i] * glm::vec3(x[i], y[i], z[i]);
+        }
+        node.Mass = total;
+        node.CenterOfMass = total > 0.0f ? weighted / total : node.Center;
+        this->nodes[nodeIndex] = node;
+        return;
+    }
+
+    // counting sort of this node's slice into its eight octants
+    unsigned int octantCount[8] = { 0 };
+    auto octantOf = [&](unsigned int i) {
+        return (x[i] >= node.Center.x ? 1u : 0u) | (y[i] >= node.Center.y ? 2u : 0u) | (z[i] >= node.Center.z ? 4u : 0u);
+    };
+    for (unsigned int k = node.First; k < node.First + node.Count; ++k)
+        octantCount[octantOf(this->order[k])]++;
+
+    unsigned int octantStart[8];
+    unsigned int running = node.First;
+    for (unsigned int c = 0; c < 8; ++c) { octantStart[c] = running; running += octantCount[c]; }
+
+    unsigned int cursor[8];
+    std::copy(octantStart, octantStart + 8, cursor);
+    for (unsigned int k = node.First; k < node.First + node.Count; ++k) {
+        unsigned int i = this->order[k];
+        this->scratch[cursor[octantOf(i)]++] = i;
+    }
+    std::copy(this->scratch.begin() + node.First, this->scratch.begin() + node.First + node.Count, this->order.begin() + node.First);
+
+    float childHalf = 0.5f * node.HalfSize;
+    for (unsigned int c = 0; c < 8; ++c)
+    {
+        if (octantCount[c] == 0) continue;
+
+        Node child;
+        child.Center = node.Center + glm::vec3((c & 1) ? childHalf : -childHalf,
+                                               (c & 2) ? childHalf : -childHalf,
+                                               (c & 4) ? childHalf : -childHalf);
+        child.HalfSize = childHalf;
+        child.First = octantStart[c];
+        child.Count = octantCount[c];
+
+        unsigned int childIndex = (unsigned int)this->nodes.size();
+        this->nodes.push_back(child);
+        node.Children[c] = childIndex;
+        this->buildNode(childIndex, depth + 1, x, y, z, m);
+    }
+
+    float total = 0.0f;
+    glm::vec3 weighted(0.0f);
+    for (unsigned int c = 0; c < 8; ++c) {
+        if (node.Children[c] == 0) continue;
+        const Node& child = this->nodes[node.Children[c]];
+        total += child.Mass;
+        weighted += child.Mass * child.CenterOfMass;
+    }
+    node.Mass = total;
+    node.CenterOfMass = total > 0.0f ? weighted / total : node.Center;
+    this->nodes[nodeIndex] = node;
+}
+
+glm::vec3 Octree::Field(const glm::vec3& position, float theta, float softening) const
+{
+    glm::vec3 field(0.0f);
+    if (this->nodes.empty()) return field;
+
+    const float eps2 = softening * softening;
+    const float theta2 = theta * theta;
+
+    unsigned int stack[TRAVERSAL_STACK];
+    unsigned int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0)
+    {
+        const Node& node = this->nodes[stack[--top]];
+        glm::vec3 d = node.CenterOfMass - position;
+        float dist2 = glm::dot(d, d);
+        float size = 2.0f * node.HalfSize;
+
+        if (node.Leaf)
+        {
+            for (unsigned int k = node.First; k < node.First + node.Count; ++k)
+            {
+                glm::vec3 dk(this->posX[k] - position.x, this->posY[k] - position.y, this->posZ[k] - position.z);
+                float r2 = glm::dot(dk, dk) + eps2;
+                float invR = 1.0f / std::sqrt(r2);
+                field += dk * (this->mass[k] * invR * invR * invR);
+            }
+        }
+        else if (size * size < theta2 * dist2)
+        {
+            float r2 = dist2 + eps2;
+            float invR = 1.0f / std::sqrt(r2);
+            field += d * (node.Mass * invR * invR * invR);
+        }
+        else
+        {
+            for (unsigned int c = 0; c < 8; ++c)
+                if (node.Children[c] != 0) stack[top++] = node.Children[c];
+        }
+    }
+    return field;
+}
@@ -0,0 +1,323 @@
+#include "ParticleMesh.h"
+#include <algorithm>
+#include <cmath>
+
+// heights above the sheet the off-sheet kernels are tabulated at
+const float MESH_LEVELS[] = { 0.0f, 1.0f, 3.0f };
+const unsigned int MESH_LEVEL_COUNT = sizeof(MESH_LEVELS) / sizeof(MESH_LEVELS[0]);
+// the potential, then x slope, z slope and vertical weight per level
+const unsigned int MESH_FIELD_COUNT = 1 + 3 * MESH_LEVEL_COUNT;
+const unsigned int MESH_GRAIN = 8;
+
+// std::complex's operator* guards against inf/nan with a library call per product
+static inline std::complex<float> multiply(const std::complex<float>& a, const std::complex<float>& b)
+{
+    return std::complex<float>(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+ParticleMesh::ParticleMesh(const PotentialField& lattice, float softening)
+    : lattice(&lattice), softening(softening), columns(lattice.Columns()), rows(lattice.Rows()),
+      meshMass(0.0f), farMass(0.0f), sheetY(0.0f), centreX(0.0f), centreZ(0.0f), weightedX(0.0f), weightedY(0.0f), weightedZ(0.0f)
+{
+    this->padded = 1;
+    while (this->padded < 2 * std::max(this->columns, this->rows))
+        this->padded *= 2;
+    const unsigned int n = this->padded;
+
+    // offsets from -(n/2 - 1) to n/2 reach every source from every window vertex
+    this->windowCol = (int)this->columns - (int)(n / 2);
+    this->windowRow = (int)this->rows - (int)(n / 2);
+    this->windowColumns = n - this->columns + 1;
+    this->windowRows = n - this->rows + 1;
+
+    this->twiddles.resize(n / 2);
+    this->inverseTwiddles.resize(n / 2);
+    for (unsigned int k = 0; k < n / 2; ++k) {
+        this->twiddles[k] = std::polar(1.0f, -6.2831853f * k / n);
+        this->inverseTwiddles[k] = std::conj(this->twiddles[k]);
+    }
+    unsigned int bits = 0;
+    while ((1u << bits) < n) bits++;
+    this->bitReverse.resize(n);
+    for (unsigned int i = 0; i < n; ++i) {
+        unsigned int r = 0;
+        for (unsigned int b = 0; b < bits; ++b)
+            if (i & (1u << b)) r |= 1u << (bits - 1 - b);
+        this->bitReverse[i] = r;
+    }
+
+    // kernel spectra, with the inverse transform's 1 / n^2 folded in
+    const float spacing = lattice.Spacing();
+    const float norm = 1.0f / ((float)n * (float)n);
+    this->kernels.assign((MESH_FIELD_COUNT + 1) / 2, std::vector<std::complex<float>>(n * n));
+    std::vector<std::complex<float>> kernel(n * n);
+    for (unsigned int f = 0; f < MESH_FIELD_COUNT; ++f)
+    {
+        const unsigned int level = f == 0 ? 0 : (f - 1) / 3;
+        const unsigned int kind = f == 0 ? 3 : (f - 1) % 3;
+        const float s2 = softening * softening + MESH_LEVELS[level] * MESH_LEVELS[level];
+        for (unsigned int row = 0; row < n; ++row)
+            for (unsigned int col = 0; col < n; ++col) {
+                // vertex minus source
+                float dx = (col <= n / 2 ? (float)col : (float)col - n) * spacing;
+                float dz = (row <= n / 2 ? (float)row : (float)row - n) * spacing;
+                float r2 = dx * dx + dz * dz + s2;
+                float inv = 1.0f / std::sqrt(r2);
+                float inv3 = inv * inv * inv;
+                float value = kind == 0 ? dx * inv3 : kind == 1 ? dz * inv3 : kind == 2 ? inv3 : -inv;
+                kernel[row * n + col] = value;
+            }
+        this->transformRows(kernel, 0, n, false, nullptr);
+        this->transformColumns(kernel, false, nullptr);
+
+        std::vector<std::complex<float>>& packed = this->kernels[f / 2];
+        const std::complex<float> weight = f % 2 == 0 ? std::complex<float>(norm, 0.0f) : std::complex<float>(0.0f, norm);
+        for (unsigned int i = 0; i < n * n; ++i)
+            packed[i] += kernel[i] * weight;
+    }
+
+    this->mass.assign(this->columns * this->rows, 0.0f);
+    this->spectrum.resize(n * n);
+    this->work.resize(n * n);
+    this->fields.assign(MESH_FIELD_COUNT, std::vector<float>(this->windowColumns * this->windowRows, 0.0f));
+}
+
+void ParticleMesh::Clear()
+{
+    std::fill(this->mass.begin(), this->mass.end(), 0.0f);
+    this->meshMass = this->farMass = 0.0f;
+    this->weightedX = this->weightedY = this->weightedZ = 0.0f;
+    this->farX.clear();
+    this->farY.clear();
+    this->farZ.clear();
+    this->farGM.clear();
+}
+
+void ParticleMesh::Deposit(const float* x, const float* y, const float* z, const float* mass, unsigned int count, float scale)
+{
+    const float spacing = this->lattice->Spacing();
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        float m = mass[i] * scale;
+        if (m == 0.0f) continue;
+
+        float fx = (x[i] - this->lattice->OriginX()) / spacing;
+        float fz = (z[i] - this->lattice->OriginZ()) / spacing;
+        float col = std::floor(fx), row = std::floor(fz);
+        if (!(col >= 0.0f && row >= 0.0f && col + 1.0f < (float)this->columns && row + 1.0f < (float)this->rows)) {
+            this->farX.push_back(x[i]);
+            this->farY.push_back(y[i]);
+            this->farZ.push_back(z[i]);
+            this->farGM.push_back(m);
+            this->farMass += m;
+            continue;
+        }
+
+        // cloud-in-cell: the four corners of the cell by area
+        fx -= col;
+        fz -= row;
+        unsigned int v = (unsigned int)row * this->columns + (unsigned int)col;
+        this->mass[v] += m * (1.0f - fx) * (1.0f - fz);
+        this->mass[v + 1] += m * fx * (1.0f - fz);
+        this->mass[v + this->columns] += m * (1.0f - fx) * fz;
+        this->mass[v + this->columns + 1] += m * fx * fz;
+
+        this->meshMass += m;
+        this->weightedX += m * x[i];
+        this->weightedY += m * y[i];
+        this->weightedZ += m * z[i];
+    }
+}
+
+void ParticleMesh::Solve(ThreadPool* pool)
+{
+    if (this->meshMass <= 0.0f) {
+        for (std::vector<float>& field : this->fields)
+            std::fill(field.begin(), field.end(), 0.0f);
+        return;
+    }
+    this->sheetY = this->weightedY / this->meshMass;
+    this->centreX = this->weightedX / this->meshMass;
+    this->centreZ = this->weightedZ / this->meshMass;
+
+    // only the lattice's rows hold mass, the padding stays zero through the row pass
+    const unsigned int n = this->padded;
+    std::fill(this->spectrum.begin(), this->spectrum.end(), std::complex<float>(0.0f));
+    for (unsigned int row = 0; row < this->rows; ++row)
+        for (unsigned int col = 0; col < this->columns; ++col)
+            this->spectrum[row * n + col] = this->mass[row * this->columns + col];
+    this->transformRows(this->spectrum, 0, this->rows, false, pool);
+    this->transformColumns(this->spectrum, false, pool);
+
+    // two real fields per inverse transform, in the real and imaginary parts
+    const unsigned int firstRow = (unsigned int)(this->windowRow + (int)n) % n;
+    for (unsigned int pair = 0; pair < this->kernels.size(); ++pair)
+    {
+        const std::vector<std::complex<float>>& kernel = this->kernels[pair];
+        for (unsigned int i = 0; i < n * n; ++i)
+            this->work[i] = multiply(this->spectrum[i], kernel[i]);
+        this->transformColumns(this->work, true, pool);
+        this->transformRows(this->work, firstRow, this->windowRows, true, pool);
+
+        std::vector<float>& even = this->fields[2 * pair];
+        std::vector<float>* odd = 2 * pair + 1 < MESH_FIELD_COUNT ? &this->fields[2 * pair + 1] : nullptr;
+        for (unsigned int wr = 0; wr < this->windowRows; ++wr) {
+            const unsigned int row = (firstRow + wr) % n;
+            for (unsigned int wc = 0; wc < this->windowColumns; ++wc) {
+                const std::complex<float> value = this->work[row * n + (unsigned int)(this->windowCol + (int)(wc + n)) % n];
+                even[wr * this->windowColumns + wc] = value.real();
+                if (odd) (*odd)[wr * this->windowColumns + wc] = value.imag();
+            }
+        }
+    }
+}
+
+float ParticleMesh::sample(const std::vector<float>& field, unsigned int cell, float fx, float fz) const
+{
+    const unsigned int w = this->windowColumns;
+    float near = field[cell] + (field[cell + 1] - field[cell]) * fx;
+    float far = field[cell + w] + (field[cell + w + 1] - field[cell + w]) * fx;
+    return near + (far - near) * fz;
+}
+
+void ParticleMesh::Acceleration(float x, float y, float z, float& ax, float& ay, float& az) const
+{
+    const float eps2 = this->softening * this->softening;
+    ax = ay = az = 0.0f;
+
+    const float dy = y - this->sheetY;
+    const float spacing = this->lattice->Spacing();
+    float fx = (x - this->lattice->OriginX()) / spacing - this->windowCol;
+    float fz = (z - this->lattice->OriginZ()) / spacing - this->windowRow;
+    float col = std::floor(fx), row = std::floor(fz);
+    if (this->meshMass <= 0.0f) {
+        // nothing on the mesh
+    } else if (col >= 0.0f && row >= 0.0f && col + 1.0f < (float)this->windowColumns && row + 1.0f < (float)this->windowRows) {
+        // the two tabulated heights around |dy| (the last two above them). near one
+        // source the vertical weight goes as (c + h^2)^(-3/2) and the slopes as that
+        // weight times a fixed offset, so w^(-2/3) and slope / w are interpolated
+        // in h^2, exact for a single source
+        const float h2 = dy * dy;
+        unsigned int lower = 0;
+        while (lower + 2 < MESH_LEVEL_COUNT && MESH_LEVELS[lower + 1] * MESH_LEVELS[lower + 1] <= h2)
+            lower++;
+        const unsigned int upper = lower + 1;
+        const float lowerH2 = MESH_LEVELS[lower] * MESH_LEVELS[lower];
+        const float upperH2 = MESH_LEVELS[upper] * MESH_LEVELS[upper];
+        const float t = (h2 - lowerH2) / (upperH2 - lowerH2);
+
+        const unsigned int cell = (unsigned int)row * this->windowColumns + (unsigned int)col;
+        fx -= col;
+        fz -= row;
+        float slope[3], lowerSlope[3], upperSlope[3];
+        for (unsigned int k = 0; k < 3; ++k) {
+            lowerSlope[k] = this->sample(this->fields[1 + 3 * lower + k], cell, fx, fz);
+            upperSlope[k] = this->sample(this->fields[1 + 3 * upper + k], cell, fx, fz);
+        }
+        const float lowerW = lowerSlope[2], upperW = upperSlope[2];
+        if (lowerW > 0.0f && upperW > 0.0f) {
+            float a = std::pow(lowerW, -2.0f / 3.0f), b = std::pow(upperW, -2.0f / 3.0f);
+            float w = std::pow(std::max(a + (b - a) * t, a * 1e-3f), -1.5f);
+            slope[0] = w * (lowerSlope[0] / lowerW + (upperSlope[0] / upperW - lowerSlope[0] / lowerW) * t);
+            slope[1] = w * (lowerSlope[1] / lowerW + (upperSlope[1] / upperW - lowerSlope[1] / lowerW) * t);
+            slope[2] = w;
+        } else {
+            for (unsigned int k = 0; k < 3; ++k)
+                slope[k] = lowerSlope[k] + (upperSlope[k] - lowerSlope[k]) * std::min(t, 1.0f);
+        }
+        ax = -slope[0];
+        az = -slope[1];
+        ay = -dy * slope[2];
+    } else {
+        float dx = x - this->centreX, dz = z - this->centreZ;
+        float r2 = dx * dx + dy * dy + dz * dz + eps2;
+        float scale = -this->meshMass / (r2 * std::sqrt(r2));
+        ax = dx * scale;
+        ay = dy * scale;
+        az = dz * scale;
+    }
+
+    for (size_t b = 0; b < this->farGM.size(); ++b) {
+        float dx = x - this->farX[b], dyb = y - this->farY[b], dz = z - this->farZ[b];
+        float r2 = dx * dx + dyb * dyb + dz * dz + eps2;
+        float scale = -this->farGM[b] / (r2 * std::sqrt(r2));
+        ax += dx * scale;
+        ay += dyb * scale;
+        az += dz * scale;
+    }
+}
+
+void ParticleMesh::Surface(float scale, float* heights, float* gradX, float* gradZ) const
+{
+    if (this->meshMass > 0.0f) {
+        for (unsigned int row = 0; row < this->rows; ++row)
+            for (unsigned int col = 0; col < this->columns; ++col) {
+                unsigned int w = (unsigned int)((int)row - this->windowRow) * this->windowColumns + (unsigned int)((int)col - this->windowCol);
+                unsigned int v = row * this->columns + col;
+                heights[v] = this->fields[0][w] * scale;
+                gradX[v] = this->fields[1][w] * scale;
+                gradZ[v] = this->fields[2][w] * scale;
+            }
+    } else {
+        // nothing on the mesh, and the fields may be from an older solve
+        const unsigned int count = this->columns * this->rows;
+        std::fill(heights, heights + count, 0.0f);
+        std::fill(gradX, gradX + count, 0.0f);
+        std::fill(gradZ, gradZ + count, 0.0f);
+    }
+    if (!this->farGM.empty())
+        this->lattice->AccumulateRegion(this->farX.data(), this->farZ.data(), this->farGM.data(), (unsigned int)this->farGM.size(),
+                                        this->softening, scale, this->lattice->All(), heights, gradX, gradZ);
+}
+
+// in-place radix-2 FFT of padded points. the inverse is
+// left unnormalised, the kernels carry the 1 / n^2
+void ParticleMesh::transform(std::complex<float>* data, bool inverse) const
+{
+    const unsigned int n = this->padded;
+    for (unsigned int i = 0; i < n; ++i) {
+        unsigned int j = this->bitReverse[i];
+        if (i < j) std::swap(data[i], data[j]);
+    }
+    const std::vector<std::complex<float>>& roots = inverse ? this->inverseTwiddles : this->twiddles;
+    for (unsigned int half = 1; half < n; half *= 2) {
+        const unsigned int step = n / (2 * half);
+        for (unsigned int k = 0; k < half; ++k) {
+            const std::complex<float> w = roots[k * step];
+            for (unsigned int start = k; start < n; start += 2 * half) {
+                std::complex<float> t = multiply(data[start + half], w);
+                data[start + half] = data[start] - t;
+                data[start] += t;
+            }
+        }
+    }
+}
+
+// count rows from first on (wrapping), each transformed along x
+void ParticleMesh::transformRows(std::vector<std::complex<float>>& data, unsigned int first, unsigned int count,
+                                 bool inverse, ThreadPool* pool) const
+{
+    const unsigned int n = this->padded;
+    auto rowRange = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int r = begin; r < end; ++r)
+            this->transform(&data[((first + r) % n) * n], inverse);
+    };
+    if (pool) pool->ParallelFor(0, count, MESH_GRAIN, rowRange);
+    else rowRange(0, count);
+}
+
+// every column along z, gathered into a contiguous copy first
+void ParticleMesh::transformColumns(std::vector<std::complex<float>>& data, bool inverse, ThreadPool* pool) const
+{
+    const unsigned int n = this->padded;
+    auto columnRange = [&](unsigned int begin, unsigned int end) {
+        std::vector<std::complex<float>> column(n);
+        for (unsigned int c = begin; c < end; ++c) {
+            for (unsigned int r = 0; r < n; ++r) column[r] = data[r * n + c];
+            this->transform(column.data(), inverse);
+            for (unsigned int r = 0; r < n; ++r) data[r * n + c] = column[r];
+        }
+    };
+    if (pool) pool->ParallelFor(0, n, MESH_GRAIN, columnRange);
+    else columnRange(0, n);
+}
@@ -0,0 +1,79 @@
+#include "ParticleStore.h"
+
+void ParticleStore::Resize(unsigned int count)
+{
+    Particle blank;
+
+    this->PosX.resize(count, blank.Position.x);
+    this->PosY.resize(count, blank.Position.y);
+    this->PosZ.resize(count, blank.Position.z);
+    this->VelX.resize(count, blank.Velocity.x);
+    this->VelY.resize(count, blank.Velocity.y);
+    this->VelZ.resize(count, blank.Velocity.z);
+    this->ForceX.resize(count, blank.Force.x);
+    this->ForceY.resize(count, blank.Force.y);
+    this->ForceZ.resize(count, blank.Force.z);
+    this->Density.resize(count, blank.Density);
+    this->Pressure.resize(count, blank.Pressure);
+    this->Life.resize(count, blank.Life);
+    this->Mass.resize(count, blank.Mass);
+    this->Color.resize(count, blank.Color);
+
+    if (this->LiveCount > count) this->LiveCount = count;
+}
+
+bool ParticleStore::Spawn(unsigned int& index)
+{
+    if (this->LiveCount >= this->Size()) return false;
+    index = this->LiveCount++;
+    return true;
+}
+
+void ParticleStore::RemoveDead()
+{
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < this->LiveCount; ++i)
+    {
+        if (this->Life[i] <= 0.0f) continue;
+        if (kept != i) {
+            this->PosX[kept] = this->PosX[i]; this->PosY[kept] = this->PosY[i]; this->PosZ[kept] = this->PosZ[i];
+            this->VelX[kept] = this->VelX[i]; this->VelY[kept] = this->VelY[i]; this->VelZ[kept] = this->VelZ[i];
+            this->ForceX[kept] = this->ForceX[i]; this->ForceY[kept] = this->ForceY[i]; this->ForceZ[kept] = this->ForceZ[i];
+            this->Density[kept]  = this->Density[i];
+            this->Pressure[kept] = this->Pressure[i];
+            this->Life[kept]     = this->Life[i];
+            this->Mass[kept]     = this->Mass[i];
+            this->Color[kept]    = this->Color[i];
+        }
+        ++kept;
+    }
+    for (unsigned int i = kept; i < this->LiveCount; ++i)
+        this->Life[i] = 0.0f;
+    this->LiveCount = kept;
+}
+
+Particle ParticleStore::Get(unsigned int i) const
+{
+    Particle p;
+    p.Position = this->Position(i);
+    p.Velocity = this->Velocity(i);
+    p.Force    = glm::vec3(this->ForceX[i], this->ForceY[i], this->ForceZ[i]);
+    p.Density  = this->Density[i];
+    p.Pressure = this->Pressure[i];
+    p.Life     = this->Life[i];
+    p.Mass     = this->Mass[i];
+    p.Color    = this->Color[i];
+    return p;
+}
+
+void ParticleStore::Set(unsigned int i, const Particle& p)
+{
+    this->PosX[i] = p.Position.x; this->PosY[i] = p.Position.y; this->PosZ[i] = p.Position.z;
+    this->VelX[i] = p.Velocity.x; this->VelY[i] = p.Velocity.y; this->VelZ[i] = p.Velocity.z;
+    this->ForceX[i] = p.Force.x; this->ForceY[i] = p.Force.y; this->ForceZ[i] = p.Force.z;
+    this->Density[i]  = p.Density;
+    this->Pressure[i] = p.Pressure;
+    this->Life[i]     = p.Life;
+    this->Mass[i]     = p.Mass;
+    this->Color[i]    = p.Color;
+}
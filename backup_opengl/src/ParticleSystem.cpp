@@ -1,9 +1,11 @@
 #include "ParticleSystem.h"
+#include "BodyForce.h"
+#include "Profiler.h"
 #include <random>
-#include <glm/gtc/random.hpp>
 #include <glm/gtc/matrix_transform.hpp> 
-#include <glm/gtc/type_ptr.hpp>         
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 const float SMOOTHING_RADIUS = 0.5f;
 const float GAS_CONST = 20.0f;
@@ -11,232 +13,446 @@ const float REST_DENSITY = 10.0f;
 const float VISCOSITY = 0.1f;
 const float PARTICLE_MASS = 1.0f; 
 
+// particles per task handed to the thread pool
+const unsigned int PARALLEL_GRAIN = 256;
+
 // kernels
 const float POLY6 = 315.0f / (64.0f * (float)M_PI * pow(SMOOTHING_RADIUS, 9));
 const float SPIKY_GRAD = -45.0f / ((float)M_PI * pow(SMOOTHING_RADIUS, 6));
 const float VISC_LAP = 45.0f / ((float)M_PI * pow(SMOOTHING_RADIUS, 6));
 
-float calculateTotalPotentialHeight(float x, float z, const std::vector<GravitationalBody>& allBodies) {
-    float totalPotential = 0.0f;
-    for (const auto& body : allBodies)
+// height of the potential surface under (x, z) and its slope, straight from the
+// bodies. used when no cached field covers the point
+static void evaluatePotentialSurface(float x, float z, const BodyRegistry& bodies,
+                                     float& height, float& gradX, float& gradZ)
+{
+    float potential = 0.0f, gx = 0.0f, gz = 0.0f;
+    for (unsigned int b = 0; b < bodies.Count; ++b)
     {
-        float dx = x - body.Position.x;
-        float dz = z - body.Position.z;
-        float rSq = dx * dx + dz * dz;
-        totalPotential += -body.GravitationalParameter / sqrt(rSq + SOFTENING_FACTOR * SOFTENING_FACTOR);
+        float dx = x - bodies.PosX[b];
+        float dz = z - bodies.PosZ[b];
+        float inv = 1.0f / std::sqrt(dx * dx + dz * dz + SOFTENING_FACTOR * SOFTENING_FACTOR);
+        potential -= bodies.GM[b] * inv;
+        float weight = bodies.GM[b] * inv * inv * inv;
+        gx += dx * weight;
+        gz += dz * weight;
     }
-    return totalPotential * VISUAL_SCALE;
+    height = potential * VISUAL_SCALE;
+    gradX = gx * VISUAL_SCALE;
+    gradZ = gz * VISUAL_SCALE;
 }
 
-ParticleSystem::ParticleSystem(GLuint shader, unsigned int amount)
-    : shader(shader), amount(amount)
+ParticleSystem::ParticleSystem(GLuint shader, unsigned int amount, unsigned int threadCount)
+    : CenterOfMass(0.0f), TotalMass(0.0f), SelfGravity(true), SelfGravityScale(2.0f), OpeningAngle(0.5f), Mesh(nullptr),
+      Scheme(Integrator::Leapfrog), LastSubsteps(1),
+      DroppedSpawns(0), neighborGrid(SMOOTHING_RADIUS), workers(threadCount), amount(amount), shader(shader), quadVBO(0), VAO(0), bodyVAO(0), poolWasFull(false),
+      random(DEFAULT_PARTICLE_SEED), spawnCount(0)
 {
     this->init();
+    if (this->shader != 0)
+        this->initRenderData();
 }
 
 ParticleSystem::~ParticleSystem()
 {
-    glDeleteVertexArrays(1, &this->VAO);
+    if (this->VAO != 0)
+        glDeleteVertexArrays(1, &this->VAO);
+    if (this->bodyVAO != 0)
+        glDeleteVertexArrays(1, &this->bodyVAO);
+    if (this->quadVBO != 0)
+        glDeleteBuffers(1, &this->quadVBO);
+}
+
+void ParticleSystem::Seed(uint32_t seed)
+{
+    this->random.seed(seed);
+    this->spawnCount = 0;
 }
 
 void ParticleSystem::init()
 {
-    GLuint VBO;
+    this->particles.Resize(this->amount);
+}
+
+void ParticleSystem::initRenderData()
+{
     float particle_quad[] = {
         -0.05f,  0.05f,  0.05f, -0.05f, -0.05f, -0.05f,
         -0.05f,  0.05f,  0.05f,  0.05f,  0.05f, -0.05f
     };
-    glGenVertexArrays(1, &this->VAO);
-    glGenBuffers(1, &VBO);
-    glBindVertexArray(this->VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glGenBuffers(1, &this->quadVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(particle_quad), particle_quad, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+    // particles and bodies draw the same quad, each from its own instance ring
+    GLuint* vaos[] = { &this->VAO, &this->bodyVAO };
+    for (GLuint* vao : vaos) {
+        glGenVertexArrays(1, vao);
+        glBindVertexArray(*vao);
+        glBindBuffer(GL_ARRAY_BUFFER, this->quadVBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    }
     glBindVertexArray(0);
 
-    for (unsigned int i = 0; i < this->amount; ++i)
-        this->particles.push_back(Particle());
+    this->instances.Init(this->VAO, this->amount);
+    this->bodyInstances.Init(this->bodyVAO, 1);
 }
 
-void ParticleSystem::Update(float dt, const std::vector<GravitationalBody>& allBodies, unsigned int newParticles, glm::vec3 spawnOffset)
+void ParticleSystem::Spawn(unsigned int count, glm::vec3 spawnOffset)
 {
-    for (unsigned int i = 0; i < newParticles; ++i)
+    PROFILE_SCOPE("Particles.Spawn");
+    bool poolFull = false;
+    for (unsigned int i = 0; i < count; ++i)
     {
-        int unusedParticle = this->firstUnusedParticle();
-        this->respawnParticle(this->particles[unusedParticle], spawnOffset);
+        unsigned int slot;
+        if (!this->particles.Spawn(slot)) {
+            this->DroppedSpawns += count - i;
+            poolFull = true;
+            break;
+        }
+        this->respawnParticle(slot, spawnOffset);
     }
+    if (poolFull && !this->poolWasFull)
+        std::cerr << "AVISO::PARTICULAS: pool de " << this->amount << " particulas esgotado, novas particulas descartadas" << std::endl;
+    this->poolWasFull = poolFull;
+}
 
-    const float restitution = 0.6f; 
-    const float epsilon = 0.01f;     
-    
-    for (Particle& p : this->particles)
-    {
-        if (p.Life > 0.0f)
-        {
-            p.Life -= dt;
-            if (p.Life > 0.0f)
-            {
-                glm::vec3 totalForce(0.0f);
-                for (const auto& body : allBodies)
-                {
-                    float distSq = glm::dot(body.Position - p.Position, body.Position - p.Position);
-                    float forceMagnitude = body.GravitationalParameter * p.Mass / (distSq + SOFTENING_FACTOR * SOFTENING_FACTOR);
-                    glm::vec3 forceDir = glm::normalize(body.Position - p.Position);
-                    totalForce += forceDir * forceMagnitude;
-                }
-                
-                p.Velocity += totalForce / p.Mass * dt;
-                p.Position += p.Velocity * dt;
-                
-                float gridHeight = calculateTotalPotentialHeight(p.Position.x, p.Position.z, allBodies);
-                
-                if (p.Position.y < gridHeight)
-                {
-                    p.Position.y = gridHeight;
+void ParticleSystem::Clear()
+{
+    this->particles.LiveCount = 0;
+    this->poolWasFull = false;
+}
 
-                    float height_px = calculateTotalPotentialHeight(p.Position.x + epsilon, p.Position.z, allBodies);
-                    float height_nx = calculateTotalPotentialHeight(p.Position.x - epsilon, p.Position.z, allBodies);
-                    float height_pz = calculateTotalPotentialHeight(p.Position.x, p.Position.z + epsilon, allBodies);
-                    float height_nz = calculateTotalPotentialHeight(p.Position.x, p.Position.z - epsilon, allBodies);
-                    
-                    glm::vec3 normal = glm::normalize(glm::vec3(height_nx - height_px, 2.0f * epsilon, height_nz - height_pz));
+void ParticleSystem::Update(float dt, const BodyRegistry& bodies, unsigned int newParticles, glm::vec3 spawnOffset)
+{
+    PROFILE_SCOPE("Particles.Update");
+    this->Spawn(newParticles, spawnOffset);
 
-                    p.Velocity = glm::reflect(p.Velocity, normal) * restitution;
-                }
+    const ParticleStore& ps = this->particles;
+    float maxSpeedSq = 0.0f, maxAccelerationSq = 0.0f;
+    for (unsigned int i = 0; i < ps.LiveCount; ++i) {
+        maxSpeedSq = std::max(maxSpeedSq, ps.VelX[i] * ps.VelX[i] + ps.VelY[i] * ps.VelY[i] + ps.VelZ[i] * ps.VelZ[i]);
+        float f2 = ps.ForceX[i] * ps.ForceX[i] + ps.ForceY[i] * ps.ForceY[i] + ps.ForceZ[i] * ps.ForceZ[i];
+        maxAccelerationSq = std::max(maxAccelerationSq, f2 / (ps.Mass[i] * ps.Mass[i]));
+    }
 
-                p.Color.a = p.Life / 8.0f;
-            }
+    this->LastSubsteps = scheduleSubsteps(dt, std::sqrt(maxSpeedSq), std::sqrt(maxAccelerationSq), SMOOTHING_RADIUS, this->Substeps);
+    const float h = dt / this->LastSubsteps;
+    for (unsigned int s = 0; s < this->LastSubsteps; ++s)
+        this->step(h, bodies);
+
+    if (!this->SelfGravity || this->Mesh)
+    {
+        float total = 0.0f;
+        glm::vec3 weighted(0.0f);
+        for (unsigned int i = 0; i < ps.LiveCount; ++i) {
+            total += ps.Mass[i];
+            weighted += ps.Mass[i] * ps.Position(i);
         }
+        this->TotalMass = total;
+        this->CenterOfMass = total > 0.0f ? weighted / total : glm::vec3(0.0f);
     }
+}
+
+// one substep: an optional leading drift, then per stage a force evaluation and a
+// fused kick + drift. the last stage also collides with the grid and ages the particles
+void ParticleSystem::step(float dt, const BodyRegistry& bodies)
+{
+    const IntegratorStages& stages = integratorStages(this->Scheme);
+    if (stages.Drift[0] != 0.0f)
+        this->integrate(0.0f, stages.Drift[0] * dt, 0.0f, bodies);
 
-    for (Particle& pi : this->particles)
+    for (unsigned int k = 0; k < stages.Kicks; ++k)
     {
-        if (pi.Life <= 0.0f) continue;
-        pi.Density = 0.0f;
-        for (Particle& pj : this->particles)
-        {
-            if (pj.Life <= 0.0f) continue;
-            glm::vec3 r_vec = pi.Position - pj.Position;
-            float r2 = glm::dot(r_vec, r_vec);
+        this->computeForces(bodies);
+        bool last = k + 1 == stages.Kicks;
+        this->integrate(stages.Kick[k] * dt, stages.Drift[k + 1] * dt, last ? dt : 0.0f, bodies);
+    }
+    this->removeDeadParticles();
+}
 
-            if (r2 < SMOOTHING_RADIUS * SMOOTHING_RADIUS)
-            {
-                pi.Density += pi.Mass * POLY6 * (float)pow(SMOOTHING_RADIUS * SMOOTHING_RADIUS - r2, 3);
-            }
-        }
-        pi.Pressure = GAS_CONST * (pi.Density - REST_DENSITY);
+// density, then Force = F_sph * m / rho + m * g: the SPH pressure and viscosity
+// force per unit volume turned into an acceleration, plus the Plummer pull of the
+// bodies and of the cloud. the tree (or the mesh) is built here, once per evaluation
+void ParticleSystem::computeForces(const BodyRegistry& bodies)
+{
+    ParticleStore& ps = this->particles;
+    // only the cloud goes on the mesh, so without self-gravity there is nothing to solve
+    ParticleMesh* mesh = this->SelfGravity ? this->Mesh : nullptr;
+    if (this->Mesh && !mesh)
+        this->Mesh->Clear();
+    if (mesh)
+    {
+        PROFILE_SCOPE("Particles.Mesh");
+        mesh->Clear();
+        mesh->Deposit(ps.PosX.data(), ps.PosY.data(), ps.PosZ.data(), ps.Mass.data(), ps.LiveCount, this->SelfGravityScale);
+        mesh->Solve(&this->workers);
+    }
+    else if (this->SelfGravity)
+    {
+        PROFILE_SCOPE("Particles.Tree");
+        this->cloudTree.Build(ps.PosX.data(), ps.PosY.data(), ps.PosZ.data(), ps.Mass.data(), ps.LiveCount);
+        this->TotalMass = this->cloudTree.TotalMass();
+        this->CenterOfMass = this->cloudTree.CenterOfMass();
     }
+    const float cloudGravity = this->SelfGravityScale;
+    const float theta = this->OpeningAngle;
 
-    for (Particle& pi : this->particles)
+    const unsigned int count = ps.LiveCount;
+    const float h2 = SMOOTHING_RADIUS * SMOOTHING_RADIUS;
     {
-        if (pi.Life <= 0.0f) continue;
-        pi.Force = glm::vec3(0.0f);
-        for (Particle& pj : this->particles)
-        {
-            if (&pi == &pj || pj.Life <= 0.0f) continue;
-            
-            glm::vec3 r_vec = pi.Position - pj.Position;
-            float r = glm::length(r_vec);
+        PROFILE_SCOPE("Particles.NeighborGrid");
+        this->neighborGrid.Build(ps);
+    }
 
-            if (r < SMOOTHING_RADIUS)
+    const float* px = ps.PosX.data();
+    const float* py = ps.PosY.data();
+    const float* pz = ps.PosZ.data();
+    const float* vx = ps.VelX.data();
+    const float* vy = ps.VelY.data();
+    const float* vz = ps.VelZ.data();
+    const float* mass = ps.Mass.data();
+    float* density = ps.Density.data();
+    float* pressure = ps.Pressure.data();
+
+    PROFILE_TIMER(densityTimer, "Particles.Density");
+    this->workers.ParallelFor(0, count, PARALLEL_GRAIN, [&](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int i = begin; i < end; ++i)
+        {
+            float rho = 0.0f;
+            this->neighborGrid.ForEachNeighbor(px[i], py[i], pz[i], [&](unsigned int j)
             {
-                float spiky_pow = (float)pow(SMOOTHING_RADIUS - r, 2);
-                
-                if (pj.Density != 0.0f) {
-                    pi.Force += -glm::normalize(r_vec) * pi.Mass * (pi.Pressure + pj.Pressure) / (2.0f * pj.Density) * SPIKY_GRAD * spiky_pow;
+                float rx = px[i] - px[j];
+                float ry = py[i] - py[j];
+                float rz = pz[i] - pz[j];
+                float r2 = rx * rx + ry * ry + rz * rz;
+
+                if (r2 < h2)
+                {
+                    float diff = h2 - r2;
+                    rho += mass[i] * POLY6 * diff * diff * diff;
                 }
-                
-                if (pj.Density != 0.0f) {
-                    pi.Force += VISCOSITY * pj.Mass * (pj.Velocity - pi.Velocity) / pj.Density * VISC_LAP * (SMOOTHING_RADIUS - r);
+            });
+            density[i] = rho;
+            pressure[i] = GAS_CONST * (rho - REST_DENSITY);
+        }
+    });
+    PROFILE_STOP(densityTimer);
+
+    PROFILE_TIMER(forceTimer, "Particles.Forces");
+    this->workers.ParallelFor(0, count, PARALLEL_GRAIN, [&](unsigned int begin, unsigned int end)
+    {
+        // the bodies' acceleration for the whole chunk first, vectorised over particles
+        float* gx = ps.ForceX.data();
+        float* gy = ps.ForceY.data();
+        float* gz = ps.ForceZ.data();
+        std::fill(gx + begin, gx + end, 0.0f);
+        std::fill(gy + begin, gy + end, 0.0f);
+        std::fill(gz + begin, gz + end, 0.0f);
+        accumulateBodyAcceleration(px + begin, py + begin, pz + begin, end - begin,
+                                   bodies.PosX.data(), bodies.PosY.data(), bodies.PosZ.data(), bodies.GM.data(),
+                                   bodies.Count, SOFTENING_FACTOR, gx + begin, gy + begin, gz + begin);
+
+        for (unsigned int i = begin; i < end; ++i)
+        {
+            float fx = 0.0f, fy = 0.0f, fz = 0.0f;
+            this->neighborGrid.ForEachNeighbor(px[i], py[i], pz[i], [&](unsigned int j)
+            {
+                if (i == j) return;
+
+                float rx = px[i] - px[j];
+                float ry = py[i] - py[j];
+                float rz = pz[i] - pz[j];
+                float r2 = rx * rx + ry * ry + rz * rz;
+
+                if (r2 < h2 && density[j] != 0.0f)
+                {
+                    float r = std::sqrt(r2);
+                    float spiky_pow = (SMOOTHING_RADIUS - r) * (SMOOTHING_RADIUS - r);
+
+                    // -normalize(r_vec) * m_i (p_i + p_j) / (2 rho_j) * spiky
+                    float pressureScale = -mass[i] * (pressure[i] + pressure[j]) / (2.0f * density[j]) * SPIKY_GRAD * spiky_pow / r;
+                    fx += rx * pressureScale;
+                    fy += ry * pressureScale;
+                    fz += rz * pressureScale;
+
+                    float viscScale = VISCOSITY * mass[j] / density[j] * VISC_LAP * (SMOOTHING_RADIUS - r);
+                    fx += (vx[j] - vx[i]) * viscScale;
+                    fy += (vy[j] - vy[i]) * viscScale;
+                    fz += (vz[j] - vz[i]) * viscScale;
                 }
+            });
+
+            glm::vec3 gravity(gx[i], gy[i], gz[i]);
+            if (mesh) {
+                // the deposit already carried cloudGravity
+                glm::vec3 cloud;
+                mesh->Acceleration(px[i], py[i], pz[i], cloud.x, cloud.y, cloud.z);
+                gravity += cloud;
+            } else if (this->SelfGravity) {
+                gravity += this->cloudTree.Field(glm::vec3(px[i], py[i], pz[i]), theta, SOFTENING_FACTOR) * cloudGravity;
             }
+
+            float sphScale = mass[i] / density[i];
+            ps.ForceX[i] = fx * sphScale + gravity.x * mass[i];
+            ps.ForceY[i] = fy * sphScale + gravity.y * mass[i];
+            ps.ForceZ[i] = fz * sphScale + gravity.z * mass[i];
         }
-    }
-    for (Particle& p : this->particles)
+    });
+    PROFILE_STOP(forceTimer);
+}
+
+// v += F / m * kick, x += v * drift. age > 0 marks the end of the substep: the
+// particle is then pushed back onto the grid surface and its life and alpha advance
+void ParticleSystem::integrate(float kick, float drift, float age, const BodyRegistry& bodies)
+{
+    PROFILE_SCOPE("Particles.Integrate");
+    const float restitution = 0.6f; 
+
+    ParticleStore& ps = this->particles;
+    this->workers.ParallelFor(0, ps.LiveCount, PARALLEL_GRAIN, [&](unsigned int begin, unsigned int end)
     {
-        if (p.Life > 0.0f)
+        for (unsigned int i = begin; i < end; ++i)
         {
-            p.Life -= dt;
-            if (p.Life > 0.0f)
+            glm::vec3 position = ps.Position(i);
+            glm::vec3 velocity = ps.Velocity(i);
+
+            if (kick != 0.0f)
+                velocity += glm::vec3(ps.ForceX[i], ps.ForceY[i], ps.ForceZ[i]) * (kick / ps.Mass[i]);
+            position += velocity * drift;
+
+            if (age > 0.0f)
             {
-                for (const auto& body : allBodies)
+                float gridHeight, slopeX, slopeZ;
+                if (!this->CollisionField.Sample(position.x, position.z, gridHeight, slopeX, slopeZ))
+                    evaluatePotentialSurface(position.x, position.z, bodies, gridHeight, slopeX, slopeZ);
+
+                if (position.y < gridHeight)
                 {
-                    float distSq = glm::dot(body.Position - p.Position, body.Position - p.Position);
-                    float forceMagnitude = body.GravitationalParameter * p.Mass / (distSq + SOFTENING_FACTOR * SOFTENING_FACTOR);
-                    glm::vec3 forceDir = glm::normalize(body.Position - p.Position);
-                    p.Force += forceDir * forceMagnitude;
+                    position.y = gridHeight;
+                    glm::vec3 normal = glm::normalize(glm::vec3(-slopeX, 1.0f, -slopeZ));
+                    velocity = glm::reflect(velocity, normal) * restitution;
                 }
-                
-                if (p.Density > 0.0f) {
-                    p.Velocity += p.Force / p.Density * dt;
-                }
-                p.Position += p.Velocity * dt;
-                
-                p.Color.a = p.Life / 8.0f;
+
+                ps.Life[i] -= age;
+                ps.Color[i].a = ps.Life[i] / 8.0f;
             }
+
+            ps.PosX[i] = position.x; ps.PosY[i] = position.y; ps.PosZ[i] = position.z;
+            ps.VelX[i] = velocity.x; ps.VelY[i] = velocity.y; ps.VelZ[i] = velocity.z;
         }
+    });
+}
+
+// compaction runs serially after each parallel pass, so the final slot order
+// does not depend on how the chunks were scheduled
+void ParticleSystem::removeDeadParticles()
+{
+    PROFILE_SCOPE("Particles.Compact");
+    this->particles.RemoveDead();
+}
+
+void ParticleSystem::Render()
+{
+    PROFILE_SCOPE("Particles.Render");
+    const ParticleStore& ps = this->particles;
+    if (this->VAO == 0 || ps.LiveCount == 0) return;
+
+    ParticleInstance* out = this->instances.Begin(ps.LiveCount);
+    for (unsigned int i = 0; i < ps.LiveCount; ++i) {
+        const glm::vec4& c = ps.Color[i];
+        out[i] = ParticleInstance{ ps.PosX[i], ps.PosY[i], ps.PosZ[i], packInstanceColor(c.r, c.g, c.b, c.a) };
     }
+    this->drawInstances(this->instances, this->VAO, ps.LiveCount);
 }
 
-void ParticleSystem::Render(const glm::mat4& view, const glm::mat4& projection)
+void ParticleSystem::RenderFrame(const SnapshotFrame& frame)
 {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    
-    glUseProgram(this->shader);
-    glUniformMatrix4fv(glGetUniformLocation(this->shader, "view"), 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(glGetUniformLocation(this->shader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    if (this->VAO == 0 || frame.ParticleCount == 0) return;
+
+    const glm::vec3 rightJet(1.0f, 0.2f, 0.2f);
+    const glm::vec3 leftJet(0.2f, 0.5f, 1.0f);
 
-    for (Particle &particle : this->particles)
+    ParticleInstance* out = this->instances.Begin(frame.ParticleCount);
+    for (unsigned int i = 0; i < frame.ParticleCount; ++i)
     {
-        if (particle.Life > 0.0f)
-        {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, particle.Position); 
-            
-            glUniformMatrix4fv(glGetUniformLocation(this->shader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-            glUniform4fv(glGetUniformLocation(this->shader, "particleColor"), 1, glm::value_ptr(particle.Color));
-
-            glBindVertexArray(this->VAO); 
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            glBindVertexArray(0);
-        }
+        glm::vec3 rgb = (frame.VelX && frame.VelX[i] < 0.0f) ? leftJet : rightJet;
+        float alpha = frame.Life ? frame.Life[i] / 8.0f : 1.0f;
+        out[i] = ParticleInstance{ frame.PosX[i], frame.PosY[i], frame.PosZ[i], packInstanceColor(rgb.r, rgb.g, rgb.b, alpha) };
     }
-    
-    glDisable(GL_BLEND);
+    this->drawInstances(this->instances, this->VAO, frame.ParticleCount);
 }
 
-unsigned int ParticleSystem::firstUnusedParticle()
+void ParticleSystem::RenderBodies(const BodyRegistry& bodies, unsigned int skip)
 {
-    for (unsigned int i = 0; i < this->amount; ++i) {
-        if (this->particles[i].Life <= 0.0f) {
-            return i;
-        }
+    if (this->bodyVAO == 0 || bodies.Count <= skip) return;
+
+    const unsigned int count = bodies.Count - skip;
+    const uint32_t color = packInstanceColor(1.0f, 0.9f, 0.7f, 1.0f);
+    ParticleInstance* out = this->bodyInstances.Begin(count);
+    for (unsigned int b = 0; b < count; ++b)
+        out[b] = ParticleInstance{ bodies.PosX[skip + b], bodies.PosY[skip + b], bodies.PosZ[skip + b], color };
+    this->drawInstances(this->bodyInstances, this->bodyVAO, count);
+}
+
+void ParticleSystem::RenderFrameBodies(const SnapshotFrame& frame, unsigned int skip)
+{
+    if (this->bodyVAO == 0 || frame.BodyCount <= skip) return;
+
+    const unsigned int count = frame.BodyCount - skip;
+    const uint32_t color = packInstanceColor(1.0f, 0.9f, 0.7f, 1.0f);
+    ParticleInstance* out = this->bodyInstances.Begin(count);
+    for (unsigned int b = 0; b < count; ++b) {
+        const float* body = frame.Bodies + (skip + b) * 4;
+        out[b] = ParticleInstance{ body[0], body[1], body[2], color };
     }
-    return 0;
+    this->drawInstances(this->bodyInstances, this->bodyVAO, count);
 }
 
-unsigned int lastUsedParticle = 0;
+void ParticleSystem::drawInstances(InstanceRing& ring, GLuint vao, unsigned int count)
+{
+    ring.Commit(count);
 
-void ParticleSystem::respawnParticle(Particle& particle, glm::vec3 spawnOffset)
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    
+    glUseProgram(this->shader);
+
+    glBindVertexArray(vao);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, count);
+    glBindVertexArray(0);
+    ring.Fence();
+
+    glDisable(GL_BLEND);
+}
+
+void ParticleSystem::respawnParticle(unsigned int index, glm::vec3 spawnOffset)
 {
     float jetSpread = 0.3f;  
     float jetSpeed = 3.0f;    
     float spawnRadius = 1.2f; 
 
     glm::vec3 jetDirection;
-    if (lastUsedParticle % 2 == 0) {
+    if (this->spawnCount % 2 == 0) {
         jetDirection = glm::vec3(1.0f, 0.0f, 0.0f); 
     } else {
         jetDirection = glm::vec3(-1.0f, 0.0f, 0.0f); 
     }
-    lastUsedParticle++;
-    if(lastUsedParticle > 1000) lastUsedParticle = 0; 
+    this->spawnCount++;
+
+    Particle particle = this->particles.Get(index);
 
     particle.Position = spawnOffset + jetDirection * spawnRadius;
     
-    glm::vec3 randomSpread = glm::ballRand(jetSpread);
+    // uniform in the ball of radius jetSpread, by rejection
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    glm::vec3 randomSpread;
+    do {
+        randomSpread = glm::vec3(unit(this->random), unit(this->random), unit(this->random));
+    } while (glm::dot(randomSpread, randomSpread) > 1.0f);
+    randomSpread *= jetSpread;
     
     particle.Velocity = (jetDirection + randomSpread) * jetSpeed;
 
@@ -248,4 +464,9 @@ void ParticleSystem::respawnParticle(Particle& particle, glm::vec3 spawnOffset)
 
     particle.Life = 8.0f; 
     particle.Mass = 1.0f;
+    // the slot may still hold a dead particle's force, which would skew the substep estimate
+    particle.Force = glm::vec3(0.0f);
+    particle.Density = 0.0f;
+
+    this->particles.Set(index, particle);
 }
\ No newline at end of file
@@ -1,68 +1,147 @@
 // src/PostProcessor.cpp
 #include "PostProcessor.h"
+#include <algorithm>
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
 
-PostProcessor::PostProcessor(GLuint postProcessShader, GLuint blurShader, unsigned int width, unsigned int height)
-    : PostProcessShader(postProcessShader), BlurShader(blurShader), Width(width), Height(height)
+const float MIN_RENDER_SCALE = 0.25f;
+const float MAX_RENDER_SCALE = 2.0f;
+
+PostProcessor::PostProcessor(const Shader& postProcessShader, const Shader& downsampleShader, const Shader& upsampleShader,
+                             unsigned int width, unsigned int height, unsigned int bloomLevels, float renderScale)
+    : PostProcessShader(postProcessShader.ID), DownsampleShader(downsampleShader.ID), UpsampleShader(upsampleShader.ID),
+      OutputWidth(std::max(width, 1u)), OutputHeight(std::max(height, 1u)), Width(0), Height(0),
+      Scale(std::min(std::max(renderScale, MIN_RENDER_SCALE), MAX_RENDER_SCALE)), RequestedBloomLevels(bloomLevels)
 {
-    glGenFramebuffers(1, &this->FBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+    this->DownsampleTexelSize = downsampleShader.Uniform("sourceTexelSize");
+    this->UpsampleTexelSize = upsampleShader.Uniform("sourceTexelSize");
+    this->EnableBloom = postProcessShader.Uniform("enableBloom");
+    this->BloomIntensity = postProcessShader.Uniform("bloomIntensity");
+
+    // sampler units never change, so they are set once here
+    postProcessShader.Use();
+    glUniform1i(postProcessShader.Uniform("sceneTexture"), 0);
+    glUniform1i(postProcessShader.Uniform("bloomTexture"), 1);
+    downsampleShader.Use();
+    glUniform1i(downsampleShader.Uniform("source"), 0);
+    upsampleShader.Use();
+    glUniform1i(upsampleShader.Uniform("source"), 0);
+    glUseProgram(0);
 
+    glGenFramebuffers(1, &this->FBO);
     glGenTextures(1, &this->SceneTexture);
-    glBindTexture(GL_TEXTURE_2D, this->SceneTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->SceneTexture, 0);
-
     glGenTextures(1, &this->BrightnessTexture);
-    glBindTexture(GL_TEXTURE_2D, this->BrightnessTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, this->BrightnessTexture, 0);
+    glGenRenderbuffers(1, &this->RBO);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+    GLuint targets[2] = { this->SceneTexture, this->BrightnessTexture };
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        glBindTexture(GL_TEXTURE_2D, targets[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, targets[i], 0);
+    }
 
     unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
     glDrawBuffers(2, attachments);
 
-    glGenRenderbuffers(1, &this->RBO);
     glBindRenderbuffer(GL_RENDERBUFFER, this->RBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->RBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    this->allocateTargets();
+    this->initRenderData();
+}
+
+void PostProcessor::allocateTargets()
+{
+    this->Width = std::max(1u, (unsigned int)(this->OutputWidth * this->Scale + 0.5f));
+    this->Height = std::max(1u, (unsigned int)(this->OutputHeight * this->Scale + 0.5f));
+
+    // re-specifying the storage keeps the names, so the attachments stay valid
+    glBindTexture(GL_TEXTURE_2D, this->SceneTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, this->Width, this->Height, 0, GL_RGBA, GL_FLOAT, NULL);
+    glBindTexture(GL_TEXTURE_2D, this->BrightnessTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, this->Width, this->Height, 0, GL_RGBA, GL_FLOAT, NULL);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->RBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, this->Width, this->Height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "ERRO::POSTPROCESSOR: FBO principal incompleto!" << std::endl;
-
-    glGenFramebuffers(2, this->PingPongFBO);
-    glGenTextures(2, this->PingPongTexture);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindFramebuffer(GL_FRAMEBUFFER, this->PingPongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, this->PingPongTexture[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->PingPongTexture[i], 0);
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "ERRO::POSTPROCESSOR: FBO Ping-pong incompleto!" << std::endl;
-    }
-    
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    this->initRenderData();
+
+    this->destroyBloomChain();
+    this->createBloomChain(this->RequestedBloomLevels);
+}
+
+void PostProcessor::Resize(unsigned int width, unsigned int height)
+{
+    if (width == 0 || height == 0) return;
+    if (width == this->OutputWidth && height == this->OutputHeight) return;
+    this->OutputWidth = width;
+    this->OutputHeight = height;
+    this->allocateTargets();
 }
 
 PostProcessor::~PostProcessor()
 {
+    this->destroyBloomChain();
     glDeleteFramebuffers(1, &this->FBO);
-    glDeleteFramebuffers(2, this->PingPongFBO);
     glDeleteTextures(1, &this->SceneTexture);
     glDeleteTextures(1, &this->BrightnessTexture);
-    glDeleteTextures(2, this->PingPongTexture);
     glDeleteRenderbuffers(1, &this->RBO);
     glDeleteVertexArrays(1, &this->QuadVAO);
 }
 
+void PostProcessor::createBloomChain(unsigned int levels)
+{
+    unsigned int mipWidth = this->Width, mipHeight = this->Height;
+    for (unsigned int i = 0; i < levels; ++i)
+    {
+        mipWidth /= 2;
+        mipHeight /= 2;
+        if (mipWidth < 2 || mipHeight < 2) break;
+
+        BloomMip mip;
+        mip.Width = mipWidth;
+        mip.Height = mipHeight;
+        glGenFramebuffers(1, &mip.FBO);
+        glGenTextures(1, &mip.Texture);
+        glBindFramebuffer(GL_FRAMEBUFFER, mip.FBO);
+        glBindTexture(GL_TEXTURE_2D, mip.Texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, mipWidth, mipHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mip.Texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERRO::POSTPROCESSOR: FBO do bloom incompleto!" << std::endl;
+        this->BloomMips.push_back(mip);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // every level ends up added into the first one; keep the total near one bright pass
+    if (!this->BloomMips.empty()) {
+        glUseProgram(this->PostProcessShader);
+        glUniform1f(this->BloomIntensity, 1.0f / this->BloomMips.size());
+        glUseProgram(0);
+    }
+}
+
+void PostProcessor::destroyBloomChain()
+{
+    for (const BloomMip& mip : this->BloomMips) {
+        glDeleteFramebuffers(1, &mip.FBO);
+        glDeleteTextures(1, &mip.Texture);
+    }
+    this->BloomMips.clear();
+}
+
 void PostProcessor::initRenderData()
 {
     GLuint VBO;
@@ -89,6 +168,7 @@ void PostProcessor::initRenderData()
 void PostProcessor::BeginRender()
 {
     glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+    glViewport(0, 0, this->Width, this->Height);
     glEnable(GL_DEPTH_TEST);
     glClearColor(0.0f, 0.0f, 0.1f, 1.0f); 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -101,42 +181,69 @@ void PostProcessor::EndRender()
 
 void PostProcessor::ProcessBloom()
 {
-    bool horizontal = true, first_iteration = true;
-    unsigned int amount = 10; 
-    
-    glUseProgram(this->BlurShader);
-    for (unsigned int i = 0; i < amount; i++)
+    if (this->BloomMips.empty()) return;
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(this->QuadVAO);
+
+    // down: bright pass -> level 0 -> level 1 ...
+    glUseProgram(this->DownsampleShader);
+    GLuint source = this->BrightnessTexture;
+    unsigned int sourceWidth = this->Width, sourceHeight = this->Height;
+    for (const BloomMip& mip : this->BloomMips)
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, this->PingPongFBO[horizontal]);
-        glUniform1i(glGetUniformLocation(this->BlurShader, "horizontal"), horizontal);
-        glBindTexture(GL_TEXTURE_2D, first_iteration ? this->BrightnessTexture : this->PingPongTexture[!horizontal]);
-        
-        glBindVertexArray(this->QuadVAO);
+        glBindFramebuffer(GL_FRAMEBUFFER, mip.FBO);
+        glViewport(0, 0, mip.Width, mip.Height);
+        glUniform2f(this->DownsampleTexelSize, 1.0f / sourceWidth, 1.0f / sourceHeight);
+        glBindTexture(GL_TEXTURE_2D, source);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        source = mip.Texture;
+        sourceWidth = mip.Width;
+        sourceHeight = mip.Height;
+    }
+
+    // up: each level is tent-filtered and added onto the next larger one
+    glUseProgram(this->UpsampleShader);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    for (size_t i = this->BloomMips.size() - 1; i > 0; --i)
+    {
+        const BloomMip& from = this->BloomMips[i];
+        const BloomMip& to = this->BloomMips[i - 1];
+        glBindFramebuffer(GL_FRAMEBUFFER, to.FBO);
+        glViewport(0, 0, to.Width, to.Height);
+        glUniform2f(this->UpsampleTexelSize, 1.0f / from.Width, 1.0f / from.Height);
+        glBindTexture(GL_TEXTURE_2D, from.Texture);
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        
-        horizontal = !horizontal;
-        if (first_iteration)
-            first_iteration = false;
     }
+    glDisable(GL_BLEND);
+
+    glBindVertexArray(0);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void PostProcessor::RenderFinalScene(bool enableBloom)
 {
+    // the scene texture is stretched to the window by linear filtering
     glUseProgram(this->PostProcessShader);
+    glViewport(0, 0, this->OutputWidth, this->OutputHeight);
     glDisable(GL_DEPTH_TEST);
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, this->SceneTexture);
-    glUniform1i(glGetUniformLocation(this->PostProcessShader, "sceneTexture"), 0);
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, this->PingPongTexture[0]);
-    glUniform1i(glGetUniformLocation(this->PostProcessShader, "bloomTexture"), 1);
+    enableBloom = enableBloom && !this->BloomMips.empty();
+    if (enableBloom) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, this->BloomMips[0].Texture);
+    }
 
-    glUniform1i(glGetUniformLocation(this->PostProcessShader, "enableBloom"), enableBloom);
+    glUniform1i(this->EnableBloom, enableBloom);
 
     glBindVertexArray(this->QuadVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
@@ -0,0 +1,358 @@
+#include "PotentialField.h"
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define POTENTIAL_FIELD_X86 1
+#include <immintrin.h>
+#endif
+
+PotentialField::PotentialField(unsigned int columns, unsigned int rows, float originX, float originZ, float spacing)
+    : columns(columns), rows(rows), originX(originX), originZ(originZ), spacing(spacing)
+{
+    this->latticeX.resize(columns * rows);
+    this->latticeZ.resize(columns * rows);
+    for (unsigned int row = 0; row < rows; ++row) {
+        for (unsigned int col = 0; col < columns; ++col) {
+            this->latticeX[row * columns + col] = originX + col * spacing;
+            this->latticeZ[row * columns + col] = originZ + row * spacing;
+        }
+    }
+}
+
+static void evaluateScalar(const float* x, const float* z, unsigned int begin, unsigned int end,
+                           const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                           float eps2, float scale, float* heights)
+{
+    for (unsigned int v = begin; v < end; ++v)
+    {
+        float potential = 0.0f;
+        for (unsigned int b = 0; b < bodyCount; ++b)
+        {
+            float dx = x[v] - bodyX[b];
+            float dz = z[v] - bodyZ[b];
+            potential -= bodyGM[b] / std::sqrt(dx * dx + dz * dz + eps2);
+        }
+        heights[v] = potential * scale;
+    }
+}
+
+static void gradientScalar(const float* x, const float* z, unsigned int begin, unsigned int end,
+                           const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                           float eps2, float scale, float* gradX, float* gradZ)
+{
+    for (unsigned int v = begin; v < end; ++v)
+    {
+        float gx = 0.0f, gz = 0.0f;
+        for (unsigned int b = 0; b < bodyCount; ++b)
+        {
+            float dx = x[v] - bodyX[b];
+            float dz = z[v] - bodyZ[b];
+            float inv = 1.0f / std::sqrt(dx * dx + dz * dz + eps2);
+            float weight = bodyGM[b] * inv * inv * inv;
+            gx += dx * weight;
+            gz += dz * weight;
+        }
+        gradX[v] = gx * scale;
+        gradZ[v] = gz * scale;
+    }
+}
+
+#ifdef POTENTIAL_FIELD_X86
+
+// lattice runs are loaded unaligned so a region's rows can start at any column.
+// rsqrt gives ~12 bits, one Newton step y * (1.5 - 0.5 * r2 * y^2) brings it to ~23
+
+__attribute__((target("sse2")))
+static unsigned int evaluateSSE(const float* x, const float* z, unsigned int count,
+                                const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                                float eps2, float scale, float* heights)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    const __m128 vEps2 = _mm_set1_ps(eps2);
+
+    unsigned int v = 0;
+    for (; v + 4 <= count; v += 4)
+    {
+        __m128 vx = _mm_loadu_ps(x + v);
+        __m128 vz = _mm_loadu_ps(z + v);
+        __m128 potential = _mm_setzero_ps();
+        for (unsigned int b = 0; b < bodyCount; ++b)
+        {
+            __m128 dx = _mm_sub_ps(vx, _mm_set1_ps(bodyX[b]));
+            __m128 dz = _mm_sub_ps(vz, _mm_set1_ps(bodyZ[b]));
+            __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)), vEps2);
+            __m128 y = _mm_rsqrt_ps(r2);
+            y = _mm_mul_ps(y, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(y, y))));
+            potential = _mm_sub_ps(potential, _mm_mul_ps(_mm_set1_ps(bodyGM[b]), y));
+        }
+        _mm_storeu_ps(heights + v, _mm_mul_ps(potential, _mm_set1_ps(scale)));
+    }
+    return v;
+}
+
+__attribute__((target("avx2,fma")))
+static unsigned int evaluateAVX2(const float* x, const float* z, unsigned int count,
+                                 const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                                 float eps2, float scale, float* heights)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 vEps2 = _mm256_set1_ps(eps2);
+
+    unsigned int v = 0;
+    for (; v + 8 <= count; v += 8)
+    {
+        __m256 vx = _mm256_loadu_ps(x + v);
+        __m256 vz = _mm256_loadu_ps(z + v);
+        __m256 potential = _mm256_setzero_ps();
+        for (unsigned int b = 0; b < bodyCount; ++b)
+        {
+            __m256 dx = _mm256_sub_ps(vx, _mm256_set1_ps(bodyX[b]));
+            __m256 dz = _mm256_sub_ps(vz, _mm256_set1_ps(bodyZ[b]));
+            __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dz, dz, vEps2));
+            __m256 y = _mm256_rsqrt_ps(r2);
+            y = _mm256_mul_ps(y, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(y, y), threeHalves));
+            potential = _mm256_fnmadd_ps(_mm256_set1_ps(bodyGM[b]), y, potential);
+        }
+        _mm256_storeu_ps(heights + v, _mm256_mul_ps(potential, _mm256_set1_ps(scale)));
+    }
+    return v;
+}
+
+__attribute__((target("sse2")))
+static unsigned int gradientSSE(const float* x, const float* z, unsigned int count,
+                                const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                                float eps2, float scale, float* gradX, float* gradZ)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    const __m128 vEps2 = _mm_set1_ps(eps2);
+
+    unsigned int v = 0;
+    for (; v + 4 <= count; v += 4)
+    {
+        __m128 vx = _mm_loadu_ps(x + v);
+        __m128 vz = _mm_loadu_ps(z + v);
+        __m128 gx = _mm_setzero_ps();
+        __m128 gz = _mm_setzero_ps();
+        for (unsigned int b = 0; b < bodyCount; ++b)
+        {
+            __m128 dx = _mm_sub_ps(vx, _mm_set1_ps(bodyX[b]));
+            __m128 dz = _mm_sub_ps(vz, _mm_set1_ps(bodyZ[b]));
+            __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)), vEps2);
+            __m128 y = _mm_rsqrt_ps(r2);
+            y = _mm_mul_ps(y, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(y, y))));
+            __m128 weight = _mm_mul_ps(_mm_set1_ps(bodyGM[b]), _mm_mul_ps(y, _mm_mul_ps(y, y)));
+            gx = _mm_add_ps(gx, _mm_mul_ps(dx, weight));
+            gz = _mm_add_ps(gz, _mm_mul_ps(dz, weight));
+        }
+        _mm_storeu_ps(gradX + v, _mm_mul_ps(gx, _mm_set1_ps(scale)));
+        _mm_storeu_ps(gradZ + v, _mm_mul_ps(gz, _mm_set1_ps(scale)));
+    }
+    return v;
+}
+
+__attribute__((target("avx2,fma")))
+static unsigned int gradientAVX2(const float* x, const float* z, unsigned int count,
+                                 const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                                 float eps2, float scale, float* gradX, float* gradZ)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 vEps2 = _mm256_set1_ps(eps2);
+
+    unsigned int v = 0;
+    for (; v + 8 <= count; v += 8)
+    {
+        __m256 vx = _mm256_loadu_ps(x + v);
+        __m256 vz = _mm256_loadu_ps(z + v);
+        __m256 gx = _mm256_setzero_ps();
+        __m256 gz = _mm256_setzero_ps();
+        for (unsigned int b = 0; b < bodyCount; ++b)
+        {
+            __m256 dx = _mm256_sub_ps(vx, _mm256_set1_ps(bodyX[b]));
+            __m256 dz = _mm256_sub_ps(vz, _mm256_set1_ps(bodyZ[b]));
+            __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dz, dz, vEps2));
+            __m256 y = _mm256_rsqrt_ps(r2);
+            y = _mm256_mul_ps(y, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(y, y), threeHalves));
+            __m256 weight = _mm256_mul_ps(_mm256_set1_ps(bodyGM[b]), _mm256_mul_ps(y, _mm256_mul_ps(y, y)));
+            gx = _mm256_fmadd_ps(dx, weight, gx);
+            gz = _mm256_fmadd_ps(dz, weight, gz);
+        }
+        _mm256_storeu_ps(gradX + v, _mm256_mul_ps(gx, _mm256_set1_ps(scale)));
+        _mm256_storeu_ps(gradZ + v, _mm256_mul_ps(gz, _mm256_set1_ps(scale)));
+    }
+    return v;
+}
+
+#endif
+
+// one contiguous run of count lattice vertices
+static void evaluateRun(const float* x, const float* z, unsigned int count,
+                        const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                        float eps2, float scale, float* heights)
+{
+    unsigned int done = 0;
+#ifdef POTENTIAL_FIELD_X86
+    switch (DetectSimdLevel()) {
+    case SimdLevel::AVX2:
+        done = evaluateAVX2(x, z, count, bodyX, bodyZ, bodyGM, bodyCount, eps2, scale, heights);
+        break;
+    case SimdLevel::SSE:
+        done = evaluateSSE(x, z, count, bodyX, bodyZ, bodyGM, bodyCount, eps2, scale, heights);
+        break;
+    default:
+        break;
+    }
+#endif
+    evaluateScalar(x, z, done, count, bodyX, bodyZ, bodyGM, bodyCount, eps2, scale, heights);
+}
+
+static void gradientRun(const float* x, const float* z, unsigned int count,
+                        const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                        float eps2, float scale, float* gradX, float* gradZ)
+{
+    unsigned int done = 0;
+#ifdef POTENTIAL_FIELD_X86
+    switch (DetectSimdLevel()) {
+    case SimdLevel::AVX2:
+        done = gradientAVX2(x, z, count, bodyX, bodyZ, bodyGM, bodyCount, eps2, scale, gradX, gradZ);
+        break;
+    case SimdLevel::SSE:
+        done = gradientSSE(x, z, count, bodyX, bodyZ, bodyGM, bodyCount, eps2, scale, gradX, gradZ);
+        break;
+    default:
+        break;
+    }
+#endif
+    gradientScalar(x, z, done, count, bodyX, bodyZ, bodyGM, bodyCount, eps2, scale, gradX, gradZ);
+}
+
+void PotentialField::Evaluate(const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                              float softening, float scale, float* heights) const
+{
+    evaluateRun(this->latticeX.data(), this->latticeZ.data(), this->VertexCount(),
+                bodyX, bodyZ, bodyGM, bodyCount, softening * softening, scale, heights);
+}
+
+void PotentialField::EvaluateGradient(const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                                      float softening, float scale, float* gradX, float* gradZ) const
+{
+    gradientRun(this->latticeX.data(), this->latticeZ.data(), this->VertexCount(),
+                bodyX, bodyZ, bodyGM, bodyCount, softening * softening, scale, gradX, gradZ);
+}
+
+void PotentialField::EvaluatePoints(const float* x, const float* z, unsigned int count,
+                                    const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                                    float softening, float scale, float* heights)
+{
+    evaluateRun(x, z, count, bodyX, bodyZ, bodyGM, bodyCount, softening * softening, scale, heights);
+}
+
+void PotentialField::AccumulateRegion(const float* bodyX, const float* bodyZ, const float* bodyGM, unsigned int bodyCount,
+                                      float softening, float scale, const LatticeRegion& region,
+                                      float* heights, float* gradX, float* gradZ) const
+{
+    if (region.Empty()) return;
+    const float eps2 = softening * softening;
+    const unsigned int width = region.ColEnd - region.ColBegin;
+    const unsigned int count = region.VertexCount();
+
+    // the region's rows are gathered into one run, so the kernels pay their
+    // scalar tail once per call rather than once per row
+    if (this->scratchX.size() < count) {
+        this->scratchX.resize(count);
+        this->scratchZ.resize(count);
+        this->scratchHeights.resize(count);
+        this->scratchGradX.resize(count);
+        this->scratchGradZ.resize(count);
+    }
+    float* x = this->scratchX.data();
+    float* z = this->scratchZ.data();
+    float* runHeights = this->scratchHeights.data();
+    float* runGradX = this->scratchGradX.data();
+    float* runGradZ = this->scratchGradZ.data();
+    for (unsigned int row = region.RowBegin, v = 0; row < region.RowEnd; ++row, v += width) {
+        const unsigned int first = row * this->columns + region.ColBegin;
+        std::copy(this->latticeX.begin() + first, this->latticeX.begin() + first + width, x + v);
+        std::copy(this->latticeZ.begin() + first, this->latticeZ.begin() + first + width, z + v);
+    }
+    evaluateRun(x, z, count, bodyX, bodyZ, bodyGM, bodyCount, eps2, scale, runHeights);
+    gradientRun(x, z, count, bodyX, bodyZ, bodyGM, bodyCount, eps2, scale, runGradX, runGradZ);
+
+    for (unsigned int row = region.RowBegin, v = 0; row < region.RowEnd; ++row) {
+        const unsigned int first = row * this->columns + region.ColBegin;
+        for (unsigned int c = 0; c < width; ++c, ++v) {
+            heights[first + c] += runHeights[v];
+            gradX[first + c] += runGradX[v];
+            gradZ[first + c] += runGradZ[v];
+        }
+    }
+}
+
+LatticeRegion PotentialField::All() const
+{
+    return LatticeRegion{ 0, this->columns, 0, this->rows };
+}
+
+LatticeRegion PotentialField::RegionAround(float minX, float minZ, float maxX, float maxZ, float radius) const
+{
+    LatticeRegion region;
+    float colLow = std::ceil((minX - radius - this->originX) / this->spacing);
+    float colHigh = std::floor((maxX + radius - this->originX) / this->spacing) + 1.0f;
+    float rowLow = std::ceil((minZ - radius - this->originZ) / this->spacing);
+    float rowHigh = std::floor((maxZ + radius - this->originZ) / this->spacing) + 1.0f;
+    region.ColBegin = (unsigned int)std::min(std::max(colLow, 0.0f), (float)this->columns);
+    region.ColEnd = (unsigned int)std::min(std::max(colHigh, 0.0f), (float)this->columns);
+    region.RowBegin = (unsigned int)std::min(std::max(rowLow, 0.0f), (float)this->rows);
+    region.RowEnd = (unsigned int)std::min(std::max(rowHigh, 0.0f), (float)this->rows);
+    return region;
+}
+
+void LatticeRegion::Merge(const LatticeRegion& other)
+{
+    if (other.Empty()) return;
+    if (this->Empty()) {
+        *this = other;
+        return;
+    }
+    this->ColBegin = std::min(this->ColBegin, other.ColBegin);
+    this->ColEnd = std::max(this->ColEnd, other.ColEnd);
+    this->RowBegin = std::min(this->RowBegin, other.RowBegin);
+    this->RowEnd = std::max(this->RowEnd, other.RowEnd);
+}
+
+bool PotentialField::Locate(float x, float z, unsigned int& vertex, float& fx, float& fz) const
+{
+    if (this->columns < 2 || this->rows < 2) return false;
+    float u = (x - this->originX) / this->spacing;
+    float w = (z - this->originZ) / this->spacing;
+    if (!(u >= 0.0f && w >= 0.0f && u <= this->columns - 1 && w <= this->rows - 1)) return false;
+
+    // the far edges belong to the last cell
+    unsigned int col = std::min((unsigned int)u, this->columns - 2);
+    unsigned int row = std::min((unsigned int)w, this->rows - 2);
+    vertex = row * this->columns + col;
+    fx = u - col;
+    fz = w - row;
+    return true;
+}
+
+bool HeightField::Sample(float x, float z, float& height, float& gradX, float& gradZ) const
+{
+    unsigned int v;
+    float fx, fz;
+    if (!this->Lattice || !this->Heights || !this->GradX || !this->GradZ || !this->Lattice->Locate(x, z, v, fx, fz)) return false;
+
+    const unsigned int below = v + this->Lattice->Columns();
+    const float w00 = (1.0f - fx) * (1.0f - fz), w10 = fx * (1.0f - fz);
+    const float w01 = (1.0f - fx) * fz,          w11 = fx * fz;
+
+    height = this->Heights[v] * w00 + this->Heights[v + 1] * w10 + this->Heights[below] * w01 + this->Heights[below + 1] * w11;
+    gradX  = this->GradX[v] * w00 + this->GradX[v + 1] * w10 + this->GradX[below] * w01 + this->GradX[below + 1] * w11;
+    gradZ  = this->GradZ[v] * w00 + this->GradZ[v + 1] * w10 + this->GradZ[below] * w01 + this->GradZ[below + 1] * w11;
+    return true;
+}
@@ -0,0 +1,94 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Profiler::enabled(false);
+
+static std::vector<ProfileEvent> ring;
+static std::atomic<uint64_t> ringWritten(0);
+static std::once_flag ringAllocated;
+static std::chrono::steady_clock::time_point epoch;
+static std::atomic<uint32_t> nextTrack(0);
+
+void Profiler::SetEnabled(bool on)
+{
+    if (on) {
+        std::call_once(ringAllocated, [] {
+            ring.resize(PROFILER_CAPACITY);
+            epoch = std::chrono::steady_clock::now();
+        });
+    }
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+uint64_t Profiler::Now()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+uint32_t Profiler::CurrentTrack()
+{
+    thread_local uint32_t track = nextTrack.fetch_add(1, std::memory_order_relaxed);
+    return track;
+}
+
+void Profiler::Record(const char* name, uint64_t start, uint64_t duration, uint32_t track)
+{
+    if (ring.empty()) return;
+    uint64_t index = ringWritten.fetch_add(1, std::memory_order_relaxed);
+    ring[index & (PROFILER_CAPACITY - 1)] = ProfileEvent{ name, start, duration, track };
+}
+
+ProfileStats Profiler::Stats(const char* name, unsigned int last, uint32_t track)
+{
+    ProfileStats stats;
+    uint64_t written = ringWritten.load(std::memory_order_relaxed);
+    uint64_t available = std::min<uint64_t>(written, ring.size());
+
+    std::vector<double> durations;
+    for (uint64_t n = 0; n < available && durations.size() < last; ++n)
+    {
+        const ProfileEvent& event = ring[(written - 1 - n) & (PROFILER_CAPACITY - 1)];
+        if (track != UINT32_MAX && event.Track != track) continue;
+        if (event.Name != name && std::strcmp(event.Name, name) != 0) continue;
+        durations.push_back(event.Duration * 1e-6);
+    }
+    if (durations.empty()) return stats;
+
+    std::sort(durations.begin(), durations.end());
+    stats.Count = (unsigned int)durations.size();
+    stats.P50 = durations[(durations.size() - 1) / 2];
+    stats.P99 = durations[(durations.size() - 1) * 99 / 100];
+    return stats;
+}
+
+bool Profiler::WriteChromeTrace(const std::string& path)
+{
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "ERRO::PROFILER: nao foi possivel escrever " << path << std::endl;
+        return false;
+    }
+
+    uint64_t written = ringWritten.load(std::memory_order_relaxed);
+    uint64_t first = written > ring.size() ? written - ring.size() : 0;
+
+    // complete ("X") events in microseconds; the GPU gets its own named track
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << PROFILER_GPU_TRACK << ",\"args\":{\"name\":\"GPU\"}}";
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    for (uint64_t n = first; n < written; ++n)
+    {
+        const ProfileEvent& event = ring[n & (PROFILER_CAPACITY - 1)];
+        out << ",\n{\"name\":\"" << event.Name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.Track
+            << ",\"ts\":" << event.Start * 1e-3 << ",\"dur\":" << event.Duration * 1e-3 << "}";
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
@@ -0,0 +1,116 @@
+#include "Scene.h"
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+struct SceneBody
+{
+    float X, Y, Z, GM, VX, VY, VZ;
+    bool Pinned;
+};
+
+static bool parseBody(std::istringstream& line, SceneBody& body)
+{
+    body = SceneBody{ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, false };
+    if (!(line >> body.X >> body.Y >> body.Z >> body.GM)) return false;
+
+    std::string word;
+    if (line >> word) {
+        if (word == "pinned") {
+            body.Pinned = true;
+            return !(line >> word);
+        }
+        std::istringstream velocity(word);
+        if (!(velocity >> body.VX) || !(line >> body.VY >> body.VZ)) return false;
+        if (line >> word) {
+            body.Pinned = word == "pinned";
+            return body.Pinned && !(line >> word);
+        }
+    }
+    return true;
+}
+
+// a disk past this is a typo, not a scene: every body is drawn and stepped
+const long long MAX_DISK_BODIES = 1000000;
+
+static bool parseDisk(std::istringstream& line, float centralGM, std::vector<SceneBody>& bodies)
+{
+    // read signed, since unsigned extraction wraps "-1" to four billion
+    long long count;
+    float inner, outer, y, gm;
+    uint32_t seed = 1;
+    if (!(line >> count >> inner >> outer >> y >> gm)) return false;
+    if (!(line >> seed)) {
+        if (!line.eof()) return false;
+        seed = 1;
+    }
+    std::string extra;
+    line.clear();
+    if (line >> extra) return false;
+    if (count < 0 || count > MAX_DISK_BODIES) return false;
+    if (inner <= 0.0f || outer < inner) return false;
+
+    // uniform in area, then the speed of a circular orbit around the mass inside
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (long long b = 0; b < count; ++b) {
+        float r = std::sqrt(inner * inner + (outer * outer - inner * inner) * unit(random));
+        float angle = 6.2831853f * unit(random);
+        float speed = centralGM > 0.0f ? std::sqrt(centralGM / r) : 0.0f;
+        float c = std::cos(angle), s = std::sin(angle);
+        bodies.push_back(SceneBody{ c * r, y, s * r, gm, -s * speed, 0.0f, c * speed, false });
+    }
+    return true;
+}
+
+bool LoadScene(const std::string& path, BodyRegistry& bodies)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "ERRO::CENA: nao foi possivel abrir " << path << std::endl;
+        return false;
+    }
+
+    // bodies already in the registry count towards the mass a disk orbits
+    float loadedGM = 0.0f;
+    for (unsigned int b = 0; b < bodies.Count; ++b)
+        loadedGM += bodies.GM[b];
+
+    std::vector<SceneBody> scene;
+    std::string text;
+    for (unsigned int lineNumber = 1; std::getline(file, text); ++lineNumber)
+    {
+        size_t comment = text.find('#');
+        if (comment != std::string::npos) text.erase(comment);
+        std::istringstream line(text);
+        std::string directive;
+        if (!(line >> directive)) continue;
+
+        bool ok = false;
+        if (directive == "body") {
+            SceneBody body;
+            ok = parseBody(line, body);
+            if (ok) {
+                scene.push_back(body);
+                loadedGM += body.GM;
+            }
+        } else if (directive == "disk") {
+            size_t first = scene.size();
+            ok = parseDisk(line, loadedGM, scene);
+            for (size_t b = first; ok && b < scene.size(); ++b)
+                loadedGM += scene[b].GM;
+        }
+        if (!ok) {
+            std::cerr << "ERRO::CENA: linha " << lineNumber << " invalida em " << path << ": " << text << std::endl;
+            return false;
+        }
+    }
+
+    bodies.Reserve(bodies.Count + (unsigned int)scene.size());
+    for (const SceneBody& body : scene)
+        bodies.Add(body.X, body.Y, body.Z, body.GM, body.VX, body.VY, body.VZ, body.Pinned);
+    return true;
+}
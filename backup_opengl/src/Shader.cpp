@@ -0,0 +1,146 @@
+#include "Shader.h"
+#include "utils.h"
+#include <iostream>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+// std140 layout of the Frame block
+struct FrameBlock {
+    float View[16];
+    float Projection[16];
+    float CameraPos[4];
+};
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath)
+    : ID(0), name(std::string(vertexPath) + " | " + fragmentPath)
+{
+    this->ID = loadShader(vertexPath, fragmentPath);
+    if (this->ID == 0) return;
+
+    this->reflect();
+    this->BindBlock("Frame", FRAME_BLOCK_BINDING);
+}
+
+Shader::~Shader()
+{
+    if (this->ID != 0)
+        glDeleteProgram(this->ID);
+}
+
+void Shader::reflect()
+{
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(this->ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(this->ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<char> buffer(maxLength > 0 ? maxLength : 1);
+    for (GLint i = 0; i < count; ++i)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(this->ID, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+        std::string uniformName(buffer.data(), length);
+
+        // members of uniform blocks have no location of their own
+        GLint location = glGetUniformLocation(this->ID, uniformName.c_str());
+        if (location < 0) continue;
+
+        this->uniforms[uniformName] = location;
+        size_t bracket = uniformName.find("[0]");
+        if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+            this->uniforms[uniformName.substr(0, bracket)] = location;
+    }
+}
+
+GLint Shader::Uniform(const std::string& uniformName) const
+{
+    auto found = this->uniforms.find(uniformName);
+    if (found != this->uniforms.end())
+        return found->second;
+
+    std::cerr << "AVISO::SHADER: uniform '" << uniformName << "' nao esta ativo em " << this->name << std::endl;
+    return -1;
+}
+
+bool Shader::BindBlock(const char* blockName, GLuint binding) const
+{
+    GLuint blockIndex = glGetUniformBlockIndex(this->ID, blockName);
+    if (blockIndex == GL_INVALID_INDEX) return false;
+    glUniformBlockBinding(this->ID, blockIndex, binding);
+    return true;
+}
+
+bool Shader::VerifyUniforms() const
+{
+    bool ok = true;
+    for (const auto& entry : this->uniforms) {
+        GLint queried = glGetUniformLocation(this->ID, entry.first.c_str());
+        if (queried != entry.second) {
+            std::cerr << "ERRO::SHADER: uniform '" << entry.first << "' em cache " << entry.second
+                      << ", driver devolve " << queried << " (" << this->name << ")" << std::endl;
+            ok = false;
+        }
+    }
+
+    // every active uniform outside a block must have made it into the cache
+    GLint count = 0;
+    glGetProgramiv(this->ID, GL_ACTIVE_UNIFORMS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        GLuint index = (GLuint)i;
+        GLint blockIndex = -1;
+        glGetActiveUniformsiv(this->ID, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+        if (blockIndex != -1) continue;
+
+        char uniformName[256];
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(this->ID, index, sizeof(uniformName), &length, &size, &type, uniformName);
+        if (this->uniforms.find(std::string(uniformName, length)) == this->uniforms.end()) {
+            std::cerr << "ERRO::SHADER: uniform ativo '" << std::string(uniformName, length)
+                      << "' fora do cache (" << this->name << ")" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+FrameUniforms::FrameUniforms()
+    : UBO(0)
+{
+}
+
+FrameUniforms::~FrameUniforms()
+{
+    if (this->UBO != 0)
+        glDeleteBuffers(1, &this->UBO);
+}
+
+void FrameUniforms::Init()
+{
+    glGenBuffers(1, &this->UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, this->UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, this->UBO);
+}
+
+void FrameUniforms::Update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos)
+{
+    FrameBlock block;
+    const float* v = glm::value_ptr(view);
+    const float* p = glm::value_ptr(projection);
+    for (int i = 0; i < 16; ++i) {
+        block.View[i] = v[i];
+        block.Projection[i] = p[i];
+    }
+    block.CameraPos[0] = cameraPos.x;
+    block.CameraPos[1] = cameraPos.y;
+    block.CameraPos[2] = cameraPos.z;
+    block.CameraPos[3] = 1.0f;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, this->UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,41 @@
+#include "Simd.h"
+#include <cstdlib>
+#include <cstring>
+
+static SimdLevel detectHardware()
+{
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SimdLevel::SSE;
+#endif
+    return SimdLevel::Scalar;
+}
+
+SimdLevel DetectSimdLevel()
+{
+    static const SimdLevel level = [] {
+        SimdLevel detected = detectHardware();
+        const char* cap = std::getenv("GRAVITY_SIMD");
+        if (cap != nullptr) {
+            SimdLevel requested = detected;
+            if (std::strcmp(cap, "scalar") == 0) requested = SimdLevel::Scalar;
+            else if (std::strcmp(cap, "sse") == 0) requested = SimdLevel::SSE;
+            else if (std::strcmp(cap, "avx2") == 0) requested = SimdLevel::AVX2;
+            if (requested < detected) detected = requested;
+        }
+        return detected;
+    }();
+    return level;
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::AVX2: return "AVX2";
+    case SimdLevel::SSE:  return "SSE";
+    default:              return "scalar";
+    }
+}
@@ -0,0 +1,655 @@
+#include "Simulation.h"
+#include "PotentialField.h"
+#include "ParticleMesh.h"
+#include "Profiler.h"
+#include "Scene.h"
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
+
+const float BASE_SPHERE_PARAMETER = 400.0f;   // força gravitacional base
+const float BASE_SPHERE_Y = 1.0f;
+const float HEIGHT_SENSITIVITY = 200.0f;
+
+// scripted sphere path for --headless: a slow orbit that also bobs up and down
+const float SCRIPT_ORBIT_RADIUS = 6.0f;
+const float SCRIPT_ORBIT_SPEED = 0.5f;
+const float SCRIPT_BOB_AMPLITUDE = 0.5f;
+
+// a moved body is re-evaluated exactly within this distance of its old and new
+// spots; further out its change is left in the cached heights and counted against
+// GRID_FIELD_TOLERANCE grid cells, the height error allowed before a full
+// evaluation (well under the lag of the eased grid)
+const float GRID_REFRESH_RADIUS = 10.0f;
+const float GRID_FIELD_TOLERANCE = 0.1f;
+// the eased grid counts as settled once no vertex is further than this from its target
+const float GRID_SETTLE_EPSILON = 1e-4f;
+
+// the default lattice until configureGrid picks another size
+static PotentialField gridField(GRID_SIZE + 1, GRID_SIZE + 1, -GRID_EXTENT / 2.0f, -GRID_EXTENT / 2.0f, GRID_SCALE);
+static std::vector<float> gridHeights(gridField.VertexCount());
+static std::vector<float> gridGradX(gridField.VertexCount()), gridGradZ(gridField.VertexCount());
+static const BodyRegistry* gridFieldBodies = nullptr;
+static uint64_t gridFieldVersion = 0;
+// the bodies as the cached field last saw them
+static std::vector<float> appliedX, appliedZ, appliedGM;
+static float gridFieldError = 0.0f;
+// vertices whose heights changed since deformGrid last copied them
+static LatticeRegion gridTargetRegion;
+static LatticeRegion gridEasingRegion;
+// with a particle mesh: the cloud's layer read off it, and the bodies' cached
+// heights plus that layer, which the grid and the collisions then use
+static std::vector<float> cloudHeights, cloudGradX, cloudGradZ;
+static std::vector<float> surfaceHeights, surfaceGradX, surfaceGradZ;
+// set while the surface arrays, not the bodies' heights alone, are shown
+static bool gridFieldFromMesh = false;
+
+// built on first use: the kernel transforms take a moment
+static std::unique_ptr<ParticleMesh> gridMeshInstance;
+static ParticleMesh& gridMesh()
+{
+    if (!gridMeshInstance)
+        gridMeshInstance.reset(new ParticleMesh(gridField, SOFTENING_FACTOR));
+    return *gridMeshInstance;
+}
+
+static void evaluateGridField(const BodyRegistry& bodies)
+{
+    gridField.Evaluate(bodies.PosX.data(), bodies.PosZ.data(), bodies.GM.data(), bodies.Count,
+                       SOFTENING_FACTOR, VISUAL_SCALE, gridHeights.data());
+    gridField.EvaluateGradient(bodies.PosX.data(), bodies.PosZ.data(), bodies.GM.data(), bodies.Count,
+                               SOFTENING_FACTOR, VISUAL_SCALE, gridGradX.data(), gridGradZ.data());
+    appliedX.assign(bodies.PosX.data(), bodies.PosX.data() + bodies.Count);
+    appliedZ.assign(bodies.PosZ.data(), bodies.PosZ.data() + bodies.Count);
+    appliedGM.assign(bodies.GM.data(), bodies.GM.data() + bodies.Count);
+    gridFieldError = 0.0f;
+    gridTargetRegion = gridField.All();
+}
+
+// heights and slopes of the potential on the grid lattice, shared by the grid
+// target and the particle collisions. skipped when the bodies have not changed;
+// when only a few moved, just the vertices around them are brought up to date
+static void updateGridField(const BodyRegistry& bodies)
+{
+    if (gridFieldBodies == &bodies && gridFieldVersion == bodies.Version())
+        return;
+
+    PROFILE_SCOPE("Grid.Field");
+    const bool known = gridFieldBodies == &bodies && appliedGM.size() == bodies.Count;
+    gridFieldBodies = &bodies;
+    gridFieldVersion = bodies.Version();
+
+    std::vector<unsigned int> moved;
+    std::vector<LatticeRegion> regions;
+    size_t regionVertices = 0;
+    float error = 0.0f;
+    if (known) {
+        const float r2 = GRID_REFRESH_RADIUS * GRID_REFRESH_RADIUS + SOFTENING_FACTOR * SOFTENING_FACTOR;
+        for (unsigned int b = 0; b < bodies.Count; ++b) {
+            if (bodies.PosX[b] == appliedX[b] && bodies.PosZ[b] == appliedZ[b] && bodies.GM[b] == appliedGM[b])
+                continue;
+            moved.push_back(b);
+            regions.push_back(gridField.RegionAround(std::min(appliedX[b], bodies.PosX[b]), std::min(appliedZ[b], bodies.PosZ[b]),
+                                                     std::max(appliedX[b], bodies.PosX[b]), std::max(appliedZ[b], bodies.PosZ[b]),
+                                                     GRID_REFRESH_RADIUS));
+            regionVertices += regions.back().VertexCount();
+            // bound on the height change left outside the refresh radius
+            float shift = std::hypot(bodies.PosX[b] - appliedX[b], bodies.PosZ[b] - appliedZ[b]);
+            float gm = std::max(bodies.GM[b], appliedGM[b]);
+            error += std::fabs(bodies.GM[b] - appliedGM[b]) / std::sqrt(r2) + gm * shift / r2;
+        }
+        if (moved.empty())
+            return;
+        error *= VISUAL_SCALE;
+    }
+    // patching costs a two-body pass (old and new spot) over each moved body's
+    // region, the full pass one pass of every body over the lattice: start over
+    // when that is no dearer, or when the far-field error is used up
+    const size_t fullCost = (size_t)bodies.Count * gridField.VertexCount();
+    if (!known || 2 * regionVertices >= fullCost || gridFieldError + error > GRID_FIELD_TOLERANCE * gridField.Spacing()) {
+        evaluateGridField(bodies);
+        return;
+    }
+
+    for (size_t m = 0; m < moved.size(); ++m) {
+        const unsigned int b = moved[m];
+        const LatticeRegion& region = regions[m];
+        // the old pull taken out and the new one added in a single pass
+        const float pairX[2] = { appliedX[b], bodies.PosX[b] };
+        const float pairZ[2] = { appliedZ[b], bodies.PosZ[b] };
+        const float pairGM[2] = { -appliedGM[b], bodies.GM[b] };
+        gridField.AccumulateRegion(pairX, pairZ, pairGM, 2, SOFTENING_FACTOR, VISUAL_SCALE, region,
+                                   gridHeights.data(), gridGradX.data(), gridGradZ.data());
+        appliedX[b] = bodies.PosX[b];
+        appliedZ[b] = bodies.PosZ[b];
+        appliedGM[b] = bodies.GM[b];
+        gridTargetRegion.Merge(region);
+    }
+    gridFieldError += error;
+}
+
+// surface = the bodies' heights + the cloud layer, everywhere
+static void composeSurface()
+{
+    surfaceHeights.resize(gridHeights.size());
+    surfaceGradX.resize(gridHeights.size());
+    surfaceGradZ.resize(gridHeights.size());
+    for (size_t v = 0; v < gridHeights.size(); ++v) {
+        surfaceHeights[v] = gridHeights[v] + cloudHeights[v];
+        surfaceGradX[v] = gridGradX[v] + cloudGradX[v];
+        surfaceGradZ[v] = gridGradZ[v] + cloudGradZ[v];
+    }
+    gridTargetRegion = gridField.All();
+}
+
+static const std::vector<float>& shownHeights()
+{
+    return gridFieldFromMesh ? surfaceHeights : gridHeights;
+}
+
+unsigned int gridSize()
+{
+    return gridField.Columns() - 1;
+}
+
+float gridSpacing()
+{
+    return gridField.Spacing();
+}
+
+void buildGridMesh(std::vector<float>& vertices, std::vector<unsigned int>& indices)
+{
+    vertices.clear();
+    indices.clear();
+    const unsigned int size = gridSize();
+    const float spacing = gridSpacing();
+    vertices.reserve((size_t)(size + 1) * (size + 1) * 3);
+    indices.reserve((size_t)size * (size + 1) * 4);
+
+    for (unsigned int j = 0; j <= size; ++j) {
+        for (unsigned int i = 0; i <= size; ++i) {
+            float x = (i - size / 2.0f) * spacing;
+            float z = (j - size / 2.0f) * spacing;
+            vertices.push_back(x);
+            vertices.push_back(0.0f);
+            vertices.push_back(z);
+        }
+    }
+
+    for (unsigned int j = 0; j < size; ++j) {
+        for (unsigned int i = 0; i < size; ++i) {
+            unsigned int row1 = j * (size + 1);
+            unsigned int row2 = (j + 1) * (size + 1);
+            indices.push_back(row1 + i); indices.push_back(row1 + i + 1);
+            indices.push_back(row1 + i); indices.push_back(row2 + i);
+        }
+    }
+    for (unsigned int i = 0; i < size; ++i) {
+        indices.push_back((size * (size + 1)) + i);
+        indices.push_back((size * (size + 1)) + i + 1);
+        indices.push_back(i * (size + 1) + size);
+        indices.push_back((i + 1) * (size + 1) + size);
+    }
+}
+
+void calculateTargetDeformation(std::vector<float>& targetVertices, const BodyRegistry& bodies) {
+    updateGridField(bodies);
+    const std::vector<float>& heights = shownHeights();
+    for (size_t v = 0; v < heights.size(); ++v)
+        targetVertices[v * 3 + 1] = heights[v];
+}
+
+float sphereGravitationalParameter(const glm::vec3& spherePos)
+{
+    float parameter = BASE_SPHERE_PARAMETER - (spherePos.y - BASE_SPHERE_Y) * HEIGHT_SENSITIVITY;
+    return std::max(0.0f, parameter);
+}
+
+void placeSphere(BodyRegistry& bodies, BodyHandle sphere, const glm::vec3& spherePos)
+{
+    bodies.Set(sphere, spherePos.x, spherePos.y, spherePos.z, sphereGravitationalParameter(spherePos));
+}
+
+void stepSimulation(ParticleSystem& particles, BodyRegistry& bodies, const glm::vec3& spawnOffset, float dt)
+{
+    //gravity logic here. the cloud's own gravity is handled inside the particle system (Barnes-Hut).
+    //the direct grid shows the bodies alone: the old loop's cloud body read a TotalMass that was
+    //never set, and the collapsed cloud as one mass would sink the grid ~130 units. --gravity mesh
+    //draws the cloud spread over the lattice
+    {
+        PROFILE_SCOPE("Bodies.Step");
+        bodies.Step(dt, SOFTENING_FACTOR, &particles.Workers());
+    }
+    // the bodies' heights are the cached direct field either way; a mesh adds the
+    // cloud's layer from the step before, re-read once the particles have moved
+    updateGridField(bodies);
+    if (gridFieldFromMesh) {
+        composeSurface();
+        particles.CollisionField = HeightField{ &gridField, surfaceHeights.data(), surfaceGradX.data(), surfaceGradZ.data() };
+    } else {
+        particles.CollisionField = HeightField{ &gridField, gridHeights.data(), gridGradX.data(), gridGradZ.data() };
+    }
+    particles.Update(dt, bodies, PARTICLES_PER_STEP, spawnOffset);
+
+    ParticleMesh* mesh = particles.Mesh;
+    if (mesh && mesh->TotalMass() > 0.0f) {
+        PROFILE_SCOPE("Grid.Field");
+        cloudHeights.resize(gridHeights.size());
+        cloudGradX.resize(gridHeights.size());
+        cloudGradZ.resize(gridHeights.size());
+        mesh->Surface(VISUAL_SCALE, cloudHeights.data(), cloudGradX.data(), cloudGradZ.data());
+        gridFieldFromMesh = true;
+        composeSurface();
+    } else if (gridFieldFromMesh) {
+        // the cloud layer is gone: back to the bodies alone
+        gridFieldFromMesh = false;
+        gridTargetRegion = gridField.All();
+    }
+}
+
+bool deformGrid(const BodyRegistry& bodies, std::vector<float>& gridVertices, std::vector<float>& targetGridVertices)
+{
+    PROFILE_SCOPE("Grid.Deform");
+    updateGridField(bodies);
+    const std::vector<float>& heights = shownHeights();
+    const unsigned int columns = gridField.Columns();
+
+    // only the heights that changed are copied into the target
+    const LatticeRegion& changed = gridTargetRegion;
+    for (unsigned int row = changed.RowBegin; row < changed.RowEnd; ++row)
+        for (unsigned int col = changed.ColBegin; col < changed.ColEnd; ++col) {
+            unsigned int v = row * columns + col;
+            targetGridVertices[v * 3 + 1] = heights[v];
+        }
+    gridEasingRegion.Merge(gridTargetRegion);
+    gridTargetRegion = LatticeRegion();
+
+    if (gridEasingRegion.Empty())
+        return false;
+
+    float furthest = 0.0f;
+    for (unsigned int row = gridEasingRegion.RowBegin; row < gridEasingRegion.RowEnd; ++row)
+        for (unsigned int col = gridEasingRegion.ColBegin; col < gridEasingRegion.ColEnd; ++col) {
+            size_t i = (row * columns + col) * 3;
+            float currentY = gridVertices[i + 1];
+            float targetY = targetGridVertices[i + 1];
+            gridVertices[i + 1] += (targetY - currentY) * GRID_SMOOTHING_FACTOR;
+            furthest = std::max(furthest, std::fabs(targetY - currentY));
+        }
+
+    // settled: land exactly on the target and stop easing until something moves
+    if (furthest < GRID_SETTLE_EPSILON) {
+        for (unsigned int row = gridEasingRegion.RowBegin; row < gridEasingRegion.RowEnd; ++row)
+            for (unsigned int col = gridEasingRegion.ColBegin; col < gridEasingRegion.ColEnd; ++col) {
+                size_t i = (row * columns + col) * 3;
+                gridVertices[i + 1] = targetGridVertices[i + 1];
+            }
+        gridEasingRegion = LatticeRegion();
+    }
+    return true;
+}
+
+bool deformLodGrid(const BodyRegistry& bodies, AdaptiveGrid& grid, bool& resized)
+{
+    PROFILE_SCOPE("Grid.Lod");
+    // with a particle mesh the cloud's layer is sampled under every vertex
+    const HeightField cloud{ &gridField, cloudHeights.data(), cloudGradX.data(), cloudGradZ.data() };
+    resized = grid.Update(bodies, SOFTENING_FACTOR, VISUAL_SCALE, gridFieldFromMesh ? &cloud : nullptr);
+    return grid.Ease(GRID_SMOOTHING_FACTOR) || resized;
+}
+
+CommandLineOptions parseCommandLine(int argc, char* argv[])
+{
+    CommandLineOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless")
+            options.Headless = true;
+        else if (arg == "--steps" && hasValue)
+            options.Steps = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--dt" && hasValue)
+            options.TimeStep = std::strtof(argv[++i], nullptr);
+        else if (arg == "--threads" && hasValue)
+            options.Threads = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--scene" && hasValue)
+            options.ScenePath = argv[++i];
+        else if (arg == "--integrator" && hasValue) {
+            if (!parseIntegrator(argv[++i], options.Scheme))
+                std::cerr << "AVISO::OPCOES: integrador desconhecido: " << argv[i] << " (euler, leapfrog, yoshida4)" << std::endl;
+        }
+        else if (arg == "--gravity" && hasValue) {
+            std::string mode = argv[++i];
+            if (mode == "mesh" || mode == "direct")
+                options.MeshGravity = mode == "mesh";
+            else
+                std::cerr << "AVISO::OPCOES: gravidade desconhecida: " << mode << " (direct, mesh)" << std::endl;
+        }
+        else if (arg == "--max-substeps" && hasValue)
+            options.MaxSubsteps = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--seed" && hasValue)
+            options.Seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--profile")
+            options.Profile = true;
+        else if (arg == "--trace" && hasValue) {
+            options.TracePath = argv[++i];
+            options.Profile = true;
+        }
+        else if (arg == "--record" && hasValue)
+            options.RecordPath = argv[++i];
+        else if (arg == "--record-append")
+            options.RecordAppend = true;
+        else if (arg == "--record-half")
+            options.RecordHalf = true;
+        else if (arg == "--record-every" && hasValue)
+            options.RecordEvery = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--replay" && hasValue)
+            options.ReplayPath = argv[++i];
+        else if (arg == "--grid-size" && hasValue)
+            options.GridSize = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--replay-frame" && hasValue)
+            options.ReplayFrame = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--grid-gpu")
+            options.GpuGrid = true;
+        else if (arg == "--grid-lod")
+            options.LodGrid = true;
+        else if (arg == "--check-shaders")
+            options.CheckShaders = true;
+        else if (arg == "--bloom-levels" && hasValue)
+            options.BloomLevels = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--render-scale" && hasValue)
+            options.RenderScale = std::strtof(argv[++i], nullptr);
+    }
+    return options;
+}
+
+bool configureGrid(const CommandLineOptions& options)
+{
+    if (options.GridSize < 2 || options.GridSize > MAX_GRID_SIZE) {
+        std::cerr << "ERRO::OPCOES: --grid-size precisa estar entre 2 e " << MAX_GRID_SIZE << std::endl;
+        return false;
+    }
+    const unsigned int side = options.GridSize + 1;
+    gridField = PotentialField(side, side, -GRID_EXTENT / 2.0f, -GRID_EXTENT / 2.0f, GRID_EXTENT / options.GridSize);
+    gridHeights.assign(gridField.VertexCount(), 0.0f);
+    gridGradX.assign(gridField.VertexCount(), 0.0f);
+    gridGradZ.assign(gridField.VertexCount(), 0.0f);
+    // everything cached against the old lattice starts over
+    gridFieldBodies = nullptr;
+    appliedX.clear();
+    appliedZ.clear();
+    appliedGM.clear();
+    gridFieldError = 0.0f;
+    gridTargetRegion = LatticeRegion();
+    gridEasingRegion = LatticeRegion();
+    cloudHeights.clear();
+    cloudGradX.clear();
+    cloudGradZ.clear();
+    gridFieldFromMesh = false;
+    gridMeshInstance.reset();
+    return true;
+}
+
+void configureParticles(ParticleSystem& particles, const CommandLineOptions& options)
+{
+    particles.Scheme = options.Scheme;
+    particles.Substeps.MaxSubsteps = options.MaxSubsteps;
+    particles.Seed(options.Seed);
+    particles.Mesh = options.MeshGravity ? &gridMesh() : nullptr;
+}
+
+bool setupBodies(BodyRegistry& bodies, BodyHandle& sphere, const CommandLineOptions& options)
+{
+    bodies.Clear();
+    sphere = bodies.Add(0.0f, BASE_SPHERE_Y, 0.0f, BASE_SPHERE_PARAMETER, 0.0f, 0.0f, 0.0f, true);
+    return options.ScenePath.empty() || LoadScene(options.ScenePath, bodies);
+}
+
+bool openRecording(SnapshotWriter& writer, const CommandLineOptions& options)
+{
+    if (options.RecordPath.empty()) return true;
+    writer.HalfPrecision = options.RecordHalf;
+    return writer.Open(options.RecordPath, options.RecordAppend);
+}
+
+void recordFrame(SnapshotWriter& writer, const ParticleSystem& particles, const BodyRegistry& bodies,
+                 const std::vector<float>& gridVertices, uint64_t step, double time)
+{
+    if (!writer.IsOpen()) return;
+    PROFILE_SCOPE("Record");
+
+    const ParticleStore& ps = particles.Particles();
+    SnapshotFrame frame;
+    frame.Step = step;
+    frame.Time = time;
+    frame.ParticleCount = ps.LiveCount;
+    frame.PosX = ps.PosX.data();
+    frame.PosY = ps.PosY.data();
+    frame.PosZ = ps.PosZ.data();
+    frame.VelX = ps.VelX.data();
+    frame.VelY = ps.VelY.data();
+    frame.VelZ = ps.VelZ.data();
+    frame.Density = ps.Density.data();
+    frame.Life = ps.Life.data();
+    frame.GridColumns = gridField.Columns();
+    frame.GridRows = gridField.Rows();
+    frame.GridHeights = gridVertices.data() + 1;
+    frame.GridStride = 3;
+    frame.GridOriginX = gridField.OriginX();
+    frame.GridOriginZ = gridField.OriginZ();
+    frame.GridSpacing = gridField.Spacing();
+
+    // the writer copies the frame, so one interleaving buffer serves every call
+    static std::vector<float> bodyRecords;
+    bodyRecords.resize(bodies.Count * 4);
+    for (unsigned int b = 0; b < bodies.Count; ++b) {
+        bodyRecords[b * 4 + 0] = bodies.PosX[b];
+        bodyRecords[b * 4 + 1] = bodies.PosY[b];
+        bodyRecords[b * 4 + 2] = bodies.PosZ[b];
+        bodyRecords[b * 4 + 3] = bodies.GM[b];
+    }
+    frame.BodyCount = bodies.Count;
+    frame.Bodies = bodyRecords.data();
+    writer.Submit(frame);
+}
+
+void closeRecording(SnapshotWriter& writer)
+{
+    if (!writer.IsOpen()) return;
+    writer.Close();
+    if (writer.FramesDropped > 0)
+        std::cerr << "AVISO::SNAPSHOT: " << writer.FramesDropped << " quadros descartados (disco lento)" << std::endl;
+}
+
+void applyReplayFrame(const SnapshotFrame& frame, glm::vec3& spherePos, std::vector<float>& gridVertices)
+{
+    if (frame.BodyCount > 0)
+        spherePos = glm::vec3(frame.Bodies[0], frame.Bodies[1], frame.Bodies[2]);
+
+    if (frame.GridHeights && frame.GridColumns == gridField.Columns() && frame.GridRows == gridField.Rows()) {
+        for (size_t v = 0; v < (size_t)frame.GridColumns * frame.GridRows; ++v)
+            gridVertices[v * 3 + 1] = frame.GridHeights[v * frame.GridStride];
+    }
+}
+
+static glm::vec3 scriptedSpherePosition(float time)
+{
+    float angle = time * SCRIPT_ORBIT_SPEED;
+    return glm::vec3(std::cos(angle) * SCRIPT_ORBIT_RADIUS,
+                     BASE_SPHERE_Y + std::sin(angle * 3.0f) * SCRIPT_BOB_AMPLITUDE,
+                     std::sin(angle) * SCRIPT_ORBIT_RADIUS);
+}
+
+glm::vec3 stepScripted(ParticleSystem& particles, BodyRegistry& bodies, BodyHandle sphere, unsigned int step, float dt)
+{
+    glm::vec3 spherePos = scriptedSpherePosition(step * dt);
+    placeSphere(bodies, sphere, spherePos);
+    stepSimulation(particles, bodies, spherePos, dt);
+    return spherePos;
+}
+
+int runHeadless(const CommandLineOptions& options)
+{
+    if (options.TimeStep <= 0.0f) {
+        std::cerr << "ERRO::HEADLESS: --dt precisa ser positivo" << std::endl;
+        return -1;
+    }
+
+    ParticleSystem particles(0, PARTICLE_POOL_SIZE, options.Threads);
+    configureParticles(particles, options);
+
+    std::vector<float> gridVertices;
+    std::vector<unsigned int> gridIndices;
+    buildGridMesh(gridVertices, gridIndices);
+    std::vector<float> targetGridVertices = gridVertices;
+    AdaptiveGrid lodGrid(GRID_EXTENT, GRID_LOD_MIN_DEPTH, GRID_LOD_MAX_DEPTH);
+    unsigned int lodResizes = 0;
+
+    glm::vec3 spherePos = scriptedSpherePosition(0.0f);
+    BodyRegistry bodies;
+    BodyHandle sphere;
+    if (!setupBodies(bodies, sphere, options))
+        return -1;
+    const double initialBodyEnergy = bodies.Energy(SOFTENING_FACTOR);
+
+    SnapshotWriter recorder;
+    if (!openRecording(recorder, options))
+        return -1;
+    Profiler::SetEnabled(options.Profile);
+
+    uint64_t substepTotal = 0;
+    unsigned int substepMax = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int step = 0; step < options.Steps; ++step)
+    {
+        PROFILE_SCOPE("Step");
+        spherePos = stepScripted(particles, bodies, sphere, step, options.TimeStep);
+        substepTotal += particles.LastSubsteps;
+        substepMax = std::max(substepMax, particles.LastSubsteps);
+        deformGrid(bodies, gridVertices, targetGridVertices);
+        if (options.LodGrid) {
+            bool resized = false;
+            deformLodGrid(bodies, lodGrid, resized);
+            lodResizes += resized;
+        }
+        if ((step + 1) % options.RecordEvery == 0)
+            recordFrame(recorder, particles, bodies, gridVertices, step + 1, (step + 1) * (double)options.TimeStep);
+    }
+    closeRecording(recorder);
+    uint64_t recordedFrames = recorder.FramesWritten();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const ParticleStore& ps = particles.Particles();
+    glm::vec3 momentum(0.0f);
+    double kineticEnergy = 0.0;
+    double potentialEnergy = 0.0;
+    for (unsigned int i = 0; i < ps.LiveCount; ++i) {
+        glm::vec3 v = ps.Velocity(i);
+        momentum += ps.Mass[i] * v;
+        kineticEnergy += 0.5 * ps.Mass[i] * glm::dot(v, v);
+        for (unsigned int b = 0; b < bodies.Count; ++b) {
+            glm::vec3 d = ps.Position(i) - glm::vec3(bodies.PosX[b], bodies.PosY[b], bodies.PosZ[b]);
+            potentialEnergy -= bodies.GM[b] * ps.Mass[i] / std::sqrt(glm::dot(d, d) + SOFTENING_FACTOR * SOFTENING_FACTOR);
+        }
+    }
+    // energy per unit mass of the live cloud in the bodies' field; compare it across
+    // integrators and --dt to see the drift, since spawning and collisions change the total
+    double specificEnergy = particles.TotalMass > 0.0f ? (kineticEnergy + potentialEnergy) / particles.TotalMass : 0.0;
+    // G times the bodies' own energy; the pinned sphere is driven from outside, so
+    // only a scene without moving pinned bodies should hold it steady
+    const double bodyEnergy = bodies.Energy(SOFTENING_FACTOR);
+    float gridMin = 0.0f;
+    for (size_t i = 1; i < gridVertices.size(); i += 3)
+        gridMin = std::min(gridMin, gridVertices[i]);
+
+    std::cout << "steps: " << options.Steps << "\n"
+              << "dt: " << options.TimeStep << "\n"
+              << "simulated_seconds: " << options.Steps * options.TimeStep << "\n"
+              << "wall_seconds: " << seconds << "\n"
+              << "steps_per_second: " << (seconds > 0.0 ? options.Steps / seconds : 0.0) << "\n"
+              << "ms_per_step: " << (options.Steps > 0 ? seconds * 1000.0 / options.Steps : 0.0) << "\n"
+              << "threads: " << particles.ThreadCount() << "\n"
+              << "integrator: " << integratorName(particles.Scheme) << "\n"
+              << "gravity: " << (particles.Mesh ? "mesh" : "direct") << "\n"
+              << "substeps_per_step: " << (options.Steps > 0 ? (double)substepTotal / options.Steps : 0.0) << "\n"
+              << "max_substeps: " << substepMax << "\n"
+              << "bodies: " << bodies.Count << "\n"
+              << "body_energy: " << bodyEnergy << "\n"
+              << "body_energy_drift: " << (initialBodyEnergy != 0.0 ? (bodyEnergy - initialBodyEnergy) / std::fabs(initialBodyEnergy) : 0.0) << "\n"
+              << "live_particles: " << particles.LiveCount() << "\n"
+              << "dropped_spawns: " << particles.DroppedSpawns << "\n"
+              << "total_mass: " << particles.TotalMass << "\n"
+              << "center_of_mass: " << particles.CenterOfMass.x << " " << particles.CenterOfMass.y << " " << particles.CenterOfMass.z << "\n"
+              << "momentum: " << momentum.x << " " << momentum.y << " " << momentum.z << "\n"
+              << "kinetic_energy: " << kineticEnergy << "\n"
+              << "potential_energy: " << potentialEnergy << "\n"
+              << "specific_energy: " << specificEnergy << "\n"
+              << "grid_min_height: " << gridMin << "\n"
+              << "recorded_frames: " << recordedFrames << "\n"
+              << "dropped_frames: " << recorder.FramesDropped << "\n"
+              << "sphere_position: " << spherePos.x << " " << spherePos.y << " " << spherePos.z << std::endl;
+    if (options.LodGrid)
+        std::cout << "grid_lod_vertices: " << lodGrid.VertexCount() << " (uniform " << gridVertices.size() / 3 << ")\n"
+                  << "grid_lod_cells: " << lodGrid.LeafCount() << "\n"
+                  << "grid_lod_resizes: " << lodResizes << std::endl;
+
+    if (options.Profile) {
+        for (const char* name : { "Step", "Bodies.Step", "Particles.Update", "Particles.Tree", "Particles.NeighborGrid", "Particles.Density",
+                                  "Particles.Forces", "Particles.Integrate", "Particles.Mesh", "Grid.Field", "Grid.Deform", "Grid.Lod" }) {
+            ProfileStats stats = Profiler::Stats(name, options.Steps * 8);
+            if (stats.Count > 0)
+                std::cout << "profile " << name << ": p50 " << stats.P50 << " ms, p99 " << stats.P99 << " ms (" << stats.Count << ")\n";
+        }
+        std::cout.flush();
+    }
+    if (!options.TracePath.empty() && !Profiler::WriteChromeTrace(options.TracePath))
+        return -1;
+    return 0;
+}
+
+int runReplayHeadless(const CommandLineOptions& options)
+{
+    SnapshotReader replay;
+    if (!replay.Open(options.ReplayPath))
+        return -1;
+
+    std::vector<float> gridVertices;
+    std::vector<unsigned int> gridIndices;
+    buildGridMesh(gridVertices, gridIndices);
+    glm::vec3 spherePos(0.0f);
+
+    // touch every particle so the pages are really read, as drawing would
+    SnapshotFrame frame;
+    double checksum = 0.0;
+    uint64_t particleTotal = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int f = options.ReplayFrame; f < replay.FrameCount(); ++f)
+    {
+        if (!replay.ReadFrame(f, frame)) {
+            std::cerr << "ERRO::SNAPSHOT: quadro corrompido: " << f << std::endl;
+            return -1;
+        }
+        applyReplayFrame(frame, spherePos, gridVertices);
+        for (unsigned int i = 0; i < frame.ParticleCount; ++i)
+            checksum += frame.PosX[i] + frame.PosY[i] + frame.PosZ[i];
+        particleTotal += frame.ParticleCount;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    unsigned int frames = replay.FrameCount() > options.ReplayFrame ? replay.FrameCount() - options.ReplayFrame : 0;
+
+    std::cout << "replay_frames: " << frames << "\n"
+              << "wall_seconds: " << seconds << "\n"
+              << "frames_per_second: " << (seconds > 0.0 ? frames / seconds : 0.0) << "\n"
+              << "ms_per_frame: " << (frames > 0 ? seconds * 1000.0 / frames : 0.0) << "\n"
+              << "particles_read: " << particleTotal << "\n"
+              << "last_step: " << frame.Step << "\n"
+              << "last_time: " << frame.Time << "\n"
+              << "position_checksum: " << checksum << "\n"
+              << "sphere_position: " << spherePos.x << " " << spherePos.y << " " << spherePos.z << std::endl;
+    return 0;
+}
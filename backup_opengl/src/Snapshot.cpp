@@ -0,0 +1,66 @@
+#include "Snapshot.h"
+#include <cstring>
+
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t exponent = (bits >> 23) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if (exponent == 0xFFu)                                   // inf / nan
+        return (uint16_t)(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+
+    int halfExponent = (int)exponent - 127 + 15;
+    if (halfExponent >= 0x1F)                                // overflow -> inf
+        return (uint16_t)(sign | 0x7C00u);
+
+    if (halfExponent <= 0)                                   // subnormal or zero
+    {
+        if (halfExponent < -10) return (uint16_t)sign;
+        mantissa |= 0x800000u;
+        uint32_t shift = (uint32_t)(14 - halfExponent);
+        uint32_t halfMantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (halfMantissa & 1u)))
+            halfMantissa++;
+        return (uint16_t)(sign | halfMantissa);
+    }
+
+    uint32_t half = sign | ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFFu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+        half++;                                              // may carry into the exponent, which is still correct
+    return (uint16_t)half;
+}
+
+float halfToFloat(uint16_t value)
+{
+    uint32_t sign = ((uint32_t)value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+    uint32_t bits;
+
+    if (exponent == 0)
+    {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // renormalise the subnormal
+            int e = -1;
+            do { e++; mantissa <<= 1; } while ((mantissa & 0x400u) == 0);
+            bits = sign | ((uint32_t)(127 - 15 - e) << 23) | ((mantissa & 0x3FFu) << 13);
+        }
+    }
+    else if (exponent == 0x1F)
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    else
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
@@ -0,0 +1,224 @@
+#include "SnapshotReader.h"
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// spacing of frames whose recorded times do not increase (appended sessions)
+const double FALLBACK_FRAME_TIME = 1.0 / 60.0;
+
+SnapshotReader::SnapshotReader()
+    : data(nullptr), size(0), offsets(nullptr), frameCount(0)
+#ifdef _WIN32
+    , fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr)
+#endif
+{
+}
+
+SnapshotReader::~SnapshotReader()
+{
+    this->Close();
+}
+
+bool SnapshotReader::Open(const std::string& path)
+{
+    this->Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "ERRO::SNAPSHOT: nao foi possivel abrir " << path << std::endl;
+        return false;
+    }
+    LARGE_INTEGER fileBytes;
+    GetFileSizeEx(file, &fileBytes);
+    HANDLE mapping = fileBytes.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        std::cerr << "ERRO::SNAPSHOT: falha ao mapear " << path << std::endl;
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    this->fileHandle = file;
+    this->mappingHandle = mapping;
+    this->size = (uint64_t)fileBytes.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "ERRO::SNAPSHOT: nao foi possivel abrir " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+        view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);   // the mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        std::cerr << "ERRO::SNAPSHOT: falha ao mapear " << path << std::endl;
+        return false;
+    }
+    this->size = (uint64_t)info.st_size;
+#endif
+    this->data = (const unsigned char*)view;
+
+    if (!this->validate()) {
+        std::cerr << "ERRO::SNAPSHOT: arquivo invalido ou incompleto: " << path << std::endl;
+        this->Close();
+        return false;
+    }
+    return true;
+}
+
+void SnapshotReader::Close()
+{
+    if (this->data) {
+#ifdef _WIN32
+        UnmapViewOfFile(this->data);
+        CloseHandle((HANDLE)this->mappingHandle);
+        CloseHandle((HANDLE)this->fileHandle);
+        this->mappingHandle = nullptr;
+        this->fileHandle = INVALID_HANDLE_VALUE;
+#else
+        munmap((void*)this->data, (size_t)this->size);
+#endif
+    }
+    this->data = nullptr;
+    this->size = 0;
+    this->offsets = nullptr;
+    this->frameCount = 0;
+}
+
+bool SnapshotReader::validate()
+{
+    if (this->size < sizeof(SnapshotFileHeader) + sizeof(SnapshotFooter)) return false;
+
+    const SnapshotFileHeader* header = (const SnapshotFileHeader*)this->data;
+    if (std::memcmp(header->Magic, SNAPSHOT_FILE_MAGIC, sizeof(header->Magic)) != 0 ||
+        header->Version != SNAPSHOT_VERSION)
+        return false;
+
+    const SnapshotFooter* footer = (const SnapshotFooter*)(this->data + this->size - sizeof(SnapshotFooter));
+    if (std::memcmp(footer->Magic, SNAPSHOT_FOOTER_MAGIC, sizeof(footer->Magic)) != 0 ||
+        footer->IndexOffset % sizeof(uint64_t) != 0 ||
+        footer->IndexOffset > this->size ||
+        footer->FrameCount > (this->size - footer->IndexOffset) / sizeof(uint64_t) ||
+        footer->IndexOffset + footer->FrameCount * sizeof(uint64_t) + sizeof(SnapshotFooter) != this->size)
+        return false;
+
+    this->offsets = (const uint64_t*)(this->data + footer->IndexOffset);
+    this->frameCount = footer->FrameCount;
+
+    // frame headers are checked once here; chunks are checked as they are read
+    for (uint64_t i = 0; i < this->frameCount; ++i) {
+        uint64_t offset = this->offsets[i];
+        if (offset % SNAPSHOT_ALIGNMENT != 0 || offset + sizeof(SnapshotFrameHeader) > footer->IndexOffset)
+            return false;
+        const SnapshotFrameHeader* frame = (const SnapshotFrameHeader*)(this->data + offset);
+        if (frame->Magic != SNAPSHOT_FRAME_MAGIC || frame->FrameBytes > footer->IndexOffset - offset)
+            return false;
+    }
+    return true;
+}
+
+bool SnapshotReader::ReadFrame(unsigned int index, SnapshotFrame& frame)
+{
+    frame = SnapshotFrame();
+    if (index >= this->frameCount) return false;
+
+    const unsigned char* base = this->data + this->offsets[index];
+    const SnapshotFrameHeader* header = (const SnapshotFrameHeader*)base;
+    frame.Step = header->Step;
+    frame.Time = header->Time;
+    frame.ParticleCount = header->ParticleCount;
+    frame.GridColumns = header->GridColumns;
+    frame.GridRows = header->GridRows;
+
+    uint64_t offset = sizeof(SnapshotFrameHeader);
+    for (uint32_t c = 0; c < header->ChunkCount; ++c)
+    {
+        if (offset + sizeof(SnapshotChunkHeader) > header->FrameBytes) return false;
+        const SnapshotChunkHeader* chunk = (const SnapshotChunkHeader*)(base + offset);
+        offset += sizeof(SnapshotChunkHeader);
+        if (offset + chunk->PayloadBytes > header->FrameBytes) return false;
+
+        const bool half = chunk->Encoding == ENCODING_FLOAT16;
+        if ((uint64_t)chunk->Count * (half ? sizeof(uint16_t) : sizeof(float)) > chunk->PayloadBytes)
+            return false;
+
+        const float* values = (const float*)(base + offset);
+        if (half && chunk->Type <= CHUNK_BODIES) {
+            std::vector<float>& widened = this->scratch[chunk->Type];
+            widened.resize(chunk->Count);
+            const uint16_t* packed = (const uint16_t*)(base + offset);
+            for (uint32_t i = 0; i < chunk->Count; ++i)
+                widened[i] = halfToFloat(packed[i]);
+            values = widened.data();
+        }
+        offset += chunk->PayloadBytes;
+
+        const uint32_t particles = header->ParticleCount;
+        switch (chunk->Type) {
+        case CHUNK_POSITION_X: if (chunk->Count == particles) frame.PosX = values; break;
+        case CHUNK_POSITION_Y: if (chunk->Count == particles) frame.PosY = values; break;
+        case CHUNK_POSITION_Z: if (chunk->Count == particles) frame.PosZ = values; break;
+        case CHUNK_VELOCITY_X: if (chunk->Count == particles) frame.VelX = values; break;
+        case CHUNK_VELOCITY_Y: if (chunk->Count == particles) frame.VelY = values; break;
+        case CHUNK_VELOCITY_Z: if (chunk->Count == particles) frame.VelZ = values; break;
+        case CHUNK_DENSITY:    if (chunk->Count == particles) frame.Density = values; break;
+        case CHUNK_LIFE:       if (chunk->Count == particles) frame.Life = values; break;
+        case CHUNK_GRID_HEIGHT:
+            if (chunk->Count == header->GridColumns * header->GridRows) frame.GridHeights = values;
+            break;
+        case CHUNK_GRID_LATTICE:
+            if (chunk->Count == 3) {
+                frame.GridOriginX = values[0];
+                frame.GridOriginZ = values[1];
+                frame.GridSpacing = values[2];
+            }
+            break;
+        case CHUNK_BODIES:
+            frame.BodyCount = chunk->Count / 4;
+            frame.Bodies = values;
+            break;
+        default:
+            break;   // chunk types from newer writers are skipped
+        }
+    }
+
+    // a frame without positions has no particles worth drawing
+    if (!frame.PosX || !frame.PosY || !frame.PosZ)
+        frame.ParticleCount = 0;
+    return true;
+}
+
+double SnapshotReader::frameTime(unsigned int index) const
+{
+    return ((const SnapshotFrameHeader*)(this->data + this->offsets[index]))->Time;
+}
+
+unsigned int SnapshotReader::Advance(unsigned int index, double& elapsed) const
+{
+    if (this->frameCount == 0) return 0;
+
+    for (uint64_t hops = 0; hops <= this->frameCount; ++hops)
+    {
+        unsigned int next = index + 1 < this->frameCount ? index + 1 : 0;
+        double duration = next == 0 ? 0.0 : this->frameTime(next) - this->frameTime(index);
+        if (duration <= 0.0) duration = FALLBACK_FRAME_TIME;
+        if (elapsed < duration) return index;
+        elapsed -= duration;
+        index = next;
+    }
+    elapsed = 0.0;   // more than a whole pass behind; just carry on from here
+    return index;
+}
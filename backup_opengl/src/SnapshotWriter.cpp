@@ -0,0 +1,267 @@
+#include "SnapshotWriter.h"
+#include <cstring>
+#include <iostream>
+
+static bool seekTo(std::FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static uint64_t fileSize(std::FILE* file)
+{
+#ifdef _WIN32
+    _fseeki64(file, 0, SEEK_END);
+    return (uint64_t)_ftelli64(file);
+#else
+    fseeko(file, 0, SEEK_END);
+    return (uint64_t)ftello(file);
+#endif
+}
+
+static void appendBytes(std::vector<unsigned char>& bytes, const void* data, size_t size)
+{
+    const unsigned char* src = (const unsigned char*)data;
+    bytes.insert(bytes.end(), src, src + size);
+}
+
+static void appendChunk(std::vector<unsigned char>& bytes, uint32_t type, bool half,
+                        const float* values, unsigned int count, unsigned int stride)
+{
+    if (values == nullptr || count == 0) return;
+
+    SnapshotChunkHeader chunk;
+    chunk.Type = type;
+    chunk.Encoding = half ? ENCODING_FLOAT16 : ENCODING_FLOAT32;
+    chunk.Count = count;
+    uint64_t raw = (uint64_t)count * (half ? sizeof(uint16_t) : sizeof(float));
+    chunk.PayloadBytes = (uint32_t)snapshotAlign(raw);
+    appendBytes(bytes, &chunk, sizeof(chunk));
+
+    size_t start = bytes.size();
+    bytes.resize(start + chunk.PayloadBytes, 0);
+    unsigned char* dst = bytes.data() + start;
+    if (half) {
+        uint16_t* out = (uint16_t*)dst;
+        for (unsigned int i = 0; i < count; ++i)
+            out[i] = floatToHalf(values[(size_t)i * stride]);
+    } else if (stride == 1) {
+        std::memcpy(dst, values, count * sizeof(float));
+    } else {
+        float* out = (float*)dst;
+        for (unsigned int i = 0; i < count; ++i)
+            out[i] = values[(size_t)i * stride];
+    }
+}
+
+SnapshotWriter::SnapshotWriter(bool halfPrecision)
+    : FramesDropped(0), HalfPrecision(halfPrecision), queueHead(0), queueSize(0),
+      file(nullptr), writeOffset(0), failed(false), stopping(false)
+{
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    this->Close();
+}
+
+bool SnapshotWriter::Open(const std::string& path, bool append)
+{
+    this->Close();
+    this->frameOffsets.clear();
+    this->FramesDropped = 0;
+    this->failed = false;
+    this->stopping = false;
+
+    if (append) {
+        this->file = std::fopen(path.c_str(), "r+b");
+        if (this->file && !this->readIndex()) {
+            std::cerr << "ERRO::SNAPSHOT: arquivo existente sem indice valido: " << path << std::endl;
+            std::fclose(this->file);
+            this->file = nullptr;
+            return false;
+        }
+    }
+
+    if (!this->file) {
+        // new file (or append to a file that does not exist yet)
+        this->file = std::fopen(path.c_str(), "wb");
+        if (!this->file) {
+            std::cerr << "ERRO::SNAPSHOT: nao foi possivel abrir " << path << std::endl;
+            return false;
+        }
+        SnapshotFileHeader header;
+        std::memcpy(header.Magic, SNAPSHOT_FILE_MAGIC, sizeof(header.Magic));
+        header.Version = SNAPSHOT_VERSION;
+        header.Reserved = 0;
+        std::fwrite(&header, sizeof(header), 1, this->file);
+        this->writeOffset = sizeof(header);
+    }
+
+    // new frames overwrite the old footer; Close writes a longer one after them
+    seekTo(this->file, this->writeOffset);
+    this->ioThread = std::thread(&SnapshotWriter::ioLoop, this);
+    return true;
+}
+
+bool SnapshotWriter::readIndex()
+{
+    SnapshotFileHeader header;
+    if (std::fread(&header, sizeof(header), 1, this->file) != 1 ||
+        std::memcmp(header.Magic, SNAPSHOT_FILE_MAGIC, sizeof(header.Magic)) != 0 ||
+        header.Version != SNAPSHOT_VERSION)
+        return false;
+
+    uint64_t size = fileSize(this->file);
+    if (size < sizeof(header) + sizeof(SnapshotFooter)) return false;
+
+    SnapshotFooter footer;
+    if (!seekTo(this->file, size - sizeof(footer)) ||
+        std::fread(&footer, sizeof(footer), 1, this->file) != 1 ||
+        std::memcmp(footer.Magic, SNAPSHOT_FOOTER_MAGIC, sizeof(footer.Magic)) != 0 ||
+        footer.IndexOffset + footer.FrameCount * sizeof(uint64_t) + sizeof(footer) != size)
+        return false;
+
+    this->frameOffsets.resize(footer.FrameCount);
+    if (footer.FrameCount > 0 &&
+        (!seekTo(this->file, footer.IndexOffset) ||
+         std::fread(this->frameOffsets.data(), sizeof(uint64_t), footer.FrameCount, this->file) != footer.FrameCount))
+        return false;
+
+    this->writeOffset = footer.IndexOffset;
+    return true;
+}
+
+void SnapshotWriter::Close()
+{
+    if (!this->file) return;
+
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->stopping = true;
+    }
+    this->frameReady.notify_all();
+    if (this->ioThread.joinable())
+        this->ioThread.join();
+
+    SnapshotFooter footer;
+    footer.FrameCount = this->frameOffsets.size();
+    footer.IndexOffset = this->writeOffset;
+    std::memcpy(footer.Magic, SNAPSHOT_FOOTER_MAGIC, sizeof(footer.Magic));
+    footer.Reserved = 0;
+
+    seekTo(this->file, this->writeOffset);
+    if (!this->frameOffsets.empty())
+        std::fwrite(this->frameOffsets.data(), sizeof(uint64_t), this->frameOffsets.size(), this->file);
+    std::fwrite(&footer, sizeof(footer), 1, this->file);
+
+    if (std::fclose(this->file) != 0 || this->failed)
+        std::cerr << "ERRO::SNAPSHOT: falha ao gravar o arquivo de snapshot" << std::endl;
+    this->file = nullptr;
+}
+
+uint64_t SnapshotWriter::FramesWritten()
+{
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->frameOffsets.size();
+}
+
+bool SnapshotWriter::Submit(const SnapshotFrame& frame)
+{
+    if (!this->file) return false;
+
+    int slot = -1;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        for (int i = 0; i < BUFFER_COUNT && slot < 0; ++i)
+            if (!this->buffers[i].Busy) slot = i;
+        if (slot < 0 || this->failed) {
+            this->FramesDropped++;
+            return false;
+        }
+        this->buffers[slot].Busy = true;
+    }
+
+    // a busy buffer belongs to the I/O thread, a free one only to us, so the
+    // encode runs without the lock
+    this->encode(frame, this->buffers[slot].Bytes);
+
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->queued[(this->queueHead + this->queueSize) % BUFFER_COUNT] = slot;
+        this->queueSize++;
+    }
+    this->frameReady.notify_one();
+    return true;
+}
+
+void SnapshotWriter::encode(const SnapshotFrame& frame, std::vector<unsigned char>& bytes) const
+{
+    bytes.clear();
+
+    SnapshotFrameHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.Magic = SNAPSHOT_FRAME_MAGIC;
+    header.Step = frame.Step;
+    header.Time = frame.Time;
+    header.ParticleCount = frame.ParticleCount;
+    header.GridColumns = frame.GridHeights ? frame.GridColumns : 0;
+    header.GridRows = frame.GridHeights ? frame.GridRows : 0;
+    appendBytes(bytes, &header, sizeof(header));
+
+    const bool half = this->HalfPrecision;
+    const unsigned int n = frame.ParticleCount;
+    appendChunk(bytes, CHUNK_POSITION_X, half, frame.PosX, n, 1);
+    appendChunk(bytes, CHUNK_POSITION_Y, half, frame.PosY, n, 1);
+    appendChunk(bytes, CHUNK_POSITION_Z, half, frame.PosZ, n, 1);
+    appendChunk(bytes, CHUNK_VELOCITY_X, half, frame.VelX, n, 1);
+    appendChunk(bytes, CHUNK_VELOCITY_Y, half, frame.VelY, n, 1);
+    appendChunk(bytes, CHUNK_VELOCITY_Z, half, frame.VelZ, n, 1);
+    appendChunk(bytes, CHUNK_DENSITY, half, frame.Density, n, 1);
+    appendChunk(bytes, CHUNK_LIFE, half, frame.Life, n, 1);
+    appendChunk(bytes, CHUNK_GRID_HEIGHT, half, frame.GridHeights,
+                header.GridColumns * header.GridRows, frame.GridStride);
+    if (frame.GridHeights && frame.GridSpacing > 0.0f) {
+        const float lattice[3] = { frame.GridOriginX, frame.GridOriginZ, frame.GridSpacing };
+        appendChunk(bytes, CHUNK_GRID_LATTICE, false, lattice, 3, 1);
+    }
+    appendChunk(bytes, CHUNK_BODIES, false, frame.Bodies, frame.BodyCount * 4, 1);
+
+    // chunk count and size are only known now
+    SnapshotFrameHeader* written = (SnapshotFrameHeader*)bytes.data();
+    uint32_t chunkCount = 0;
+    for (size_t offset = sizeof(header); offset < bytes.size(); ++chunkCount)
+        offset += sizeof(SnapshotChunkHeader) + ((const SnapshotChunkHeader*)(bytes.data() + offset))->PayloadBytes;
+    written->ChunkCount = chunkCount;
+    written->FrameBytes = bytes.size();
+}
+
+void SnapshotWriter::ioLoop()
+{
+    std::unique_lock<std::mutex> guard(this->lock);
+    for (;;)
+    {
+        this->frameReady.wait(guard, [this] { return this->queueSize > 0 || this->stopping; });
+        if (this->queueSize == 0) return;   // stopping, and everything submitted is on disk
+
+        int slot = this->queued[this->queueHead];
+        FrameBuffer& buffer = this->buffers[slot];
+        guard.unlock();
+
+        bool ok = std::fwrite(buffer.Bytes.data(), 1, buffer.Bytes.size(), this->file) == buffer.Bytes.size();
+
+        guard.lock();
+        if (ok) {
+            this->frameOffsets.push_back(this->writeOffset);
+            this->writeOffset += buffer.Bytes.size();
+        } else {
+            this->failed = true;
+        }
+        this->queueHead = (this->queueHead + 1) % BUFFER_COUNT;
+        this->queueSize--;
+        buffer.Busy = false;
+    }
+}
@@ -0,0 +1,36 @@
+#include "SpatialHash.h"
+#include "ParticleStore.h"
+
+SpatialHash::SpatialHash(float cellSize)
+    : cellSize(cellSize), invCellSize(1.0f / cellSize), tableMask(0)
+{
+}
+
+void SpatialHash::Build(const ParticleStore& particles)
+{
+    const unsigned int liveCount = particles.LiveCount;
+
+    // table twice the live count keeps bucket collisions rare
+    unsigned int tableSize = 64;
+    while (tableSize < 2 * liveCount) tableSize <<= 1;
+    this->tableMask = tableSize - 1;
+
+    this->cellStart.assign(tableSize + 1, 0);
+    this->particleBucket.resize(liveCount);
+
+    for (unsigned int i = 0; i < liveCount; ++i)
+    {
+        unsigned int b = bucket(cellCoord(particles.PosX[i]), cellCoord(particles.PosY[i]), cellCoord(particles.PosZ[i]));
+        this->particleBucket[i] = b;
+        this->cellStart[b + 1]++;
+    }
+
+    // counting sort: prefix sum gives each bucket its slice of cellEntries
+    for (unsigned int b = 0; b < tableSize; ++b)
+        this->cellStart[b + 1] += this->cellStart[b];
+
+    this->cellEntries.resize(liveCount);
+    this->bucketCursor.assign(this->cellStart.begin(), this->cellStart.end() - 1);
+    for (unsigned int i = 0; i < liveCount; ++i)
+        this->cellEntries[this->bucketCursor[this->particleBucket[i]]++] = i;
+}
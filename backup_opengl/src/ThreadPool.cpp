@@ -0,0 +1,121 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+    : job(nullptr), pending(0), generation(0), stopping(false)
+{
+    if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0) threadCount = 1;
+
+    for (unsigned int i = 0; i < threadCount; ++i)
+        this->queues.emplace_back(new WorkQueue());
+
+    // the last queue belongs to the thread calling ParallelFor
+    for (unsigned int i = 0; i + 1 < threadCount; ++i)
+        this->workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->wakeLock);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (std::thread& worker : this->workers)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(unsigned int begin, unsigned int end, unsigned int grain, const RangeFunc& func)
+{
+    if (begin >= end) return;
+    if (grain == 0) grain = 1;
+
+    if (this->workers.empty() || end - begin <= grain) {
+        func(begin, end);
+        return;
+    }
+
+    // job is published before any task, and tasks are pushed under the queue
+    // locks, so whoever pops a task also sees the matching job
+    this->job = &func;
+
+    const unsigned int queueCount = (unsigned int)this->queues.size();
+    unsigned int chunkCount = (end - begin + grain - 1) / grain;
+    this->pending.store(chunkCount);
+
+    unsigned int chunk = 0;
+    for (unsigned int first = begin; first < end; first += grain, ++chunk)
+    {
+        unsigned int last = (end - first > grain) ? first + grain : end;
+        WorkQueue& queue = *this->queues[chunk % queueCount];
+        std::lock_guard<std::mutex> lock(queue.Lock);
+        queue.Tasks.push_back(Range{ first, last });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->wakeLock);
+        this->generation++;
+    }
+    this->wake.notify_all();
+
+    this->drain(queueCount - 1);
+
+    std::unique_lock<std::mutex> lock(this->doneLock);
+    this->done.wait(lock, [this] { return this->pending.load() == 0; });
+    this->job = nullptr;
+}
+
+void ThreadPool::workerLoop(unsigned int self)
+{
+    unsigned int seenGeneration = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->wakeLock);
+            this->wake.wait(lock, [&] { return this->stopping || this->generation != seenGeneration; });
+            if (this->stopping) return;
+            seenGeneration = this->generation;
+        }
+        this->drain(self);
+    }
+}
+
+void ThreadPool::drain(unsigned int self)
+{
+    Range task;
+    while (this->popOrSteal(self, task))
+    {
+        (*this->job)(task.Begin, task.End);
+
+        if (this->pending.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(this->doneLock);
+            this->done.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::popOrSteal(unsigned int self, Range& task)
+{
+    {
+        WorkQueue& own = *this->queues[self];
+        std::lock_guard<std::mutex> lock(own.Lock);
+        if (!own.Tasks.empty()) {
+            task = own.Tasks.back();
+            own.Tasks.pop_back();
+            return true;
+        }
+    }
+
+    const unsigned int queueCount = (unsigned int)this->queues.size();
+    for (unsigned int offset = 1; offset < queueCount; ++offset)
+    {
+        WorkQueue& victim = *this->queues[(self + offset) % queueCount];
+        std::lock_guard<std::mutex> lock(victim.Lock);
+        if (!victim.Tasks.empty()) {
+            task = victim.Tasks.front();
+            victim.Tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
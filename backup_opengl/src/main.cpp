@@ -7,6 +7,11 @@
 #include "ParticleSystem.h"
 #include "Physics.h"
 #include "utils.h"
+#include "Simulation.h"
+#include "GridDisplacement.h"
+#include "Shader.h"
+#include "Profiler.h"
+#include "GpuProfiler.h"
 #include <glm/gtc/type_ptr.hpp> 
 #include <iostream>
 #include <fstream>
@@ -15,15 +20,27 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <cstdio>
+#include <climits>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos);
-void calculateTargetDeformation(std::vector<float>& targetVertices, const std::vector<GravitationalBody>& allBodies);
+std::string windowTitle();
+int runWindow(GLFWwindow* window, const CommandLineOptions& options, SnapshotReader& replay);
 
 const unsigned int SCR_WIDTH = 1280, SCR_HEIGHT = 720;
+// the simulation advances in fixed --dt steps; a hitch longer than this is
+// dropped instead of being caught up, and one frame runs at most this many steps
+const float MAX_FRAME_TIME = 0.25f;
+const unsigned int MAX_STEPS_PER_FRAME = 4;
+// how often the profiling figures in the title are refreshed, in seconds
+const float PROFILE_OVERLAY_INTERVAL = 0.5f;
+// current framebuffer size; the callback only records it, the loop resizes the targets
+int framebufferWidth = SCR_WIDTH, framebufferHeight = SCR_HEIGHT;
+bool framebufferResized = false;
 glm::vec3 cameraPos   = glm::vec3(0.0f, 15.0f, 25.0f);
 glm::vec3 cameraFront = glm::vec3(0.0f, -0.5f, -1.0f);
 glm::vec3 cameraUp    = glm::vec3(0.0f, 1.0f, 0.0f);
@@ -31,20 +48,44 @@ glm::vec3 objectPos = glm::vec3(0.0f, 1.0f, 0.0f);
 bool is_panning = false;
 bool is_rotating = false;
 double last_mouse_x = 0.0, last_mouse_y = 0.0;
-const int GRID_SIZE = 100;
-const float GRID_SCALE = 0.5f;
-const float GRID_SMOOTHING_FACTOR = 0.08f;
 const std::vector<float> horizontalSpeedSettings = { 0.01f, 0.04f, 0.09f };
 const std::vector<float> verticalSpeedSettings = { 0.015f, 0.06f, 0.13f };
 const std::vector<std::string> speedNames = { "Lenta", "Normal", "Rápida" };
 int currentSpeedIndex = 1;
 bool v_key_pressed_last_frame = false;
+bool gpuGridEnabled = false;
+bool g_key_pressed_last_frame = false;
+bool b_key_pressed_last_frame = false;
+bool replayPaused = false;
+int replayStepRequest = 0;
+bool p_key_pressed_last_frame = false;
+bool left_key_pressed_last_frame = false;
+bool right_key_pressed_last_frame = false;
 bool bloomEnabled = true;
 bool lensingEnabled = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
+std::string profileOverlay;
+
+int main(int argc, char* argv[]) {
+    CommandLineOptions options = parseCommandLine(argc, argv);
+    if (!configureGrid(options))
+        return -1;
+    if (options.Headless)
+        return options.ReplayPath.empty() ? runHeadless(options) : runReplayHeadless(options);
+    if (options.TimeStep <= 0.0f) {
+        std::cerr << "ERRO::OPCOES: --dt precisa ser positivo" << std::endl;
+        return -1;
+    }
+
+    SnapshotReader replay;
+    if (!options.ReplayPath.empty() && !replay.Open(options.ReplayPath))
+        return -1;
+    if (replay.IsOpen() && replay.FrameCount() == 0) {
+        std::cerr << "ERRO::SNAPSHOT: gravacao sem quadros: " << options.ReplayPath << std::endl;
+        return -1;
+    }
 
-int main() {
     if (!glfwInit()) {
         std::cerr << "Falha ao inicializar GLFW" << std::endl;
         return -1;
@@ -53,7 +94,8 @@ int main() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    std::string initial_title = "Simulador de Gravidade [Velocidade: " + speedNames[currentSpeedIndex] + "]";
+    gpuGridEnabled = options.GpuGrid;
+    std::string initial_title = windowTitle();
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, initial_title.c_str(), NULL, NULL);
     if (window == NULL) {
         std::cerr << "Falha ao criar janela GLFW" << std::endl;
@@ -61,6 +103,7 @@ int main() {
         return -1;
     }
     glfwMakeContextCurrent(window);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
@@ -69,47 +112,72 @@ int main() {
 
     if (glewInit() != GLEW_OK) {
         std::cerr << "Falha ao inicializar GLEW" << std::endl;
+        glfwTerminate();
         return -1;
     }
 
+    // every GL object lives in runWindow, so they are all released while the context is current
+    int result = runWindow(window, options, replay);
+    glfwTerminate();
+    return result;
+}
+
+int runWindow(GLFWwindow* window, const CommandLineOptions& options, SnapshotReader& replay) {
+    const bool replaying = replay.IsOpen();
+    unsigned int replayFrame = replaying ? std::min(options.ReplayFrame, replay.FrameCount() - 1) : 0;
+    // frame stays valid until the next ReadFrame, so a paused replay reads nothing
+    unsigned int loadedFrame = UINT_MAX;
+    double replayElapsed = 0.0;
+    SnapshotFrame frame;
+
     glEnable(GL_DEPTH_TEST);
 
-    GLuint gridShader = loadShader("shaders/grid.vert", "shaders/grid.frag");
-    GLuint sphereShader = loadShader("shaders/sphere.vert", "shaders/sphere.frag");
-    GLuint postProcessShader = loadShader("shaders/postprocess.vert", "shaders/postprocess.frag");
-    GLuint particleShader = loadShader("shaders/particle.vert", "shaders/particle.frag");
-    GLuint blurShader = loadShader("shaders/blur.vert", "shaders/blur.frag");
+    Profiler::SetEnabled(options.Profile);
+    GpuProfiler gpuProfiler;
+    gpuProfiler.Init();
+    float lastOverlayUpdate = 0.0f;
+
+    Shader gridShader("shaders/grid.vert", "shaders/grid.frag");
+    Shader sphereShader("shaders/sphere.vert", "shaders/sphere.frag");
+    Shader postProcessShader("shaders/postprocess.vert", "shaders/postprocess.frag");
+    Shader particleShader("shaders/particle.vert", "shaders/particle.frag");
+    Shader bloomDownsampleShader("shaders/postprocess.vert", "shaders/bloom_downsample.frag");
+    Shader bloomUpsampleShader("shaders/postprocess.vert", "shaders/bloom_upsample.frag");
+    Shader gridGpuShader("shaders/grid_gpu.vert", "shaders/grid.frag");
+
+    if (options.CheckShaders) {
+        bool ok = true;
+        for (const Shader* shader : { &gridShader, &sphereShader, &postProcessShader, &particleShader,
+                                     &bloomDownsampleShader, &bloomUpsampleShader, &gridGpuShader })
+            ok = shader->ID != 0 && shader->VerifyUniforms() && ok;
+        std::cout << (ok ? "shaders: ok" : "shaders: falhou") << std::endl;
+        return ok ? 0 : -1;
+    }
+
+    // every location the loop needs, resolved once. values that never change are set here too
+    FrameUniforms frameUniforms;
+    frameUniforms.Init();
+
+    const GLint sphereModel = sphereShader.Uniform("model");
+    sphereShader.Use();
+    glUniform3fv(sphereShader.Uniform("objectColor"), 1, glm::value_ptr(glm::vec3(0.8f, 0.8f, 0.9f)));
+    glUniform3fv(sphereShader.Uniform("lightColor"), 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
+    glUniform3fv(sphereShader.Uniform("lightPos"), 1, glm::value_ptr(glm::vec3(5.0f, 10.0f, 5.0f)));
+
+    gridShader.Use();
+    glUniformMatrix4fv(gridShader.Uniform("model"), 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+    gridGpuShader.Use();
+    glUniformMatrix4fv(gridGpuShader.Uniform("model"), 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
+    glUniform1f(gridGpuShader.Uniform("softening"), SOFTENING_FACTOR);
+    glUniform1f(gridGpuShader.Uniform("visualScale"), VISUAL_SCALE);
+    glUseProgram(0);
 
     std::vector<float> gridVertices;
     std::vector<float> targetGridVertices; 
     std::vector<unsigned int> gridIndices;
-
-    for (int j = 0; j <= GRID_SIZE; ++j) {
-        for (int i = 0; i <= GRID_SIZE; ++i) {
-            float x = (i - GRID_SIZE / 2.0f) * GRID_SCALE;
-            float z = (j - GRID_SIZE / 2.0f) * GRID_SCALE;
-            gridVertices.push_back(x);
-            gridVertices.push_back(0.0f);
-            gridVertices.push_back(z);
-        }
-    }
+    buildGridMesh(gridVertices, gridIndices);
     targetGridVertices = gridVertices;
 
-    for (int j = 0; j < GRID_SIZE; ++j) {
-        for (int i = 0; i < GRID_SIZE; ++i) {
-            int row1 = j * (GRID_SIZE + 1);
-            int row2 = (j + 1) * (GRID_SIZE + 1);
-            gridIndices.push_back(row1 + i); gridIndices.push_back(row1 + i + 1);
-            gridIndices.push_back(row1 + i); gridIndices.push_back(row2 + i);
-        }
-    }
-    for (int i = 0; i < GRID_SIZE; ++i) {
-        gridIndices.push_back((GRID_SIZE * (GRID_SIZE + 1)) + i);
-        gridIndices.push_back((GRID_SIZE * (GRID_SIZE + 1)) + i + 1);
-        gridIndices.push_back(i * (GRID_SIZE + 1) + GRID_SIZE);
-        gridIndices.push_back((i + 1) * (GRID_SIZE + 1) + GRID_SIZE);
-    }
-
     GLuint gridVAO, gridVBO, gridEBO;
     glGenVertexArrays(1, &gridVAO);
     glGenBuffers(1, &gridVBO);
@@ -122,6 +190,57 @@ int main() {
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, gridIndices.size() * sizeof(unsigned int), gridIndices.data(), GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
+    // set whenever gridVertices moves on from what gridVBO holds
+    bool gridUploadPending = false;
+
+    // flat copy of the lattice for the GPU path; uploaded once, shares the index buffer
+    GLuint latticeVAO, latticeVBO;
+    glGenVertexArrays(1, &latticeVAO);
+    glGenBuffers(1, &latticeVBO);
+    glBindVertexArray(latticeVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, latticeVBO);
+    glBufferData(GL_ARRAY_BUFFER, gridVertices.size() * sizeof(float), gridVertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridEBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // --replay: the flat lattice again, raised by the recorded heights in their own
+    // buffer, filled straight from the frame
+    GLuint replayVAO = 0, replayHeightVBO = 0;
+    if (replaying) {
+        glGenVertexArrays(1, &replayVAO);
+        glGenBuffers(1, &replayHeightVBO);
+        glBindVertexArray(replayVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, latticeVBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridEBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        std::vector<float> flat(gridVertices.size() / 3, 0.0f);
+        glBindBuffer(GL_ARRAY_BUFFER, replayHeightVBO);
+        glBufferData(GL_ARRAY_BUFFER, flat.size() * sizeof(float), flat.data(), GL_STREAM_DRAW);
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+    }
+
+    // --grid-lod: the adaptive grid's own buffers. its cells change nearly every step
+    // while a body moves, so they are only reallocated when the lists outgrow them
+    AdaptiveGrid lodGrid(GRID_EXTENT, GRID_LOD_MIN_DEPTH, GRID_LOD_MAX_DEPTH);
+    GLuint lodVAO, lodVBO, lodEBO;
+    glGenVertexArrays(1, &lodVAO);
+    glGenBuffers(1, &lodVBO);
+    glGenBuffers(1, &lodEBO);
+    glBindVertexArray(lodVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, lodVBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lodEBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    bool lodResized = true;
+    bool lodUploadPending = true;
+    size_t lodVertexCapacity = 0, lodLineCapacity = 0;
+
+    GridDisplacement gridDisplacement;
+    gridDisplacement.Init(gridGpuShader);
+    bool gpuGridWasEnabled = false;
 
     std::vector<float> sphereVertices;
     std::vector<unsigned int> sphereIndices;
@@ -142,102 +261,246 @@ int main() {
 
     // POST PROCESSOR HERE.
 
-    PostProcessor effects(postProcessShader, blurShader, SCR_WIDTH, SCR_HEIGHT);
-    ParticleSystem particles(particleShader, 5500);
+    PostProcessor effects(postProcessShader, bloomDownsampleShader, bloomUpsampleShader, framebufferWidth, framebufferHeight,
+                          options.BloomLevels, options.RenderScale);
+    ParticleSystem particles(particleShader.ID, PARTICLE_POOL_SIZE);
     
-    const float baseSphereParameter = 400.0f;   // força gravitacional base
-    const float baseSphereY = 1.0f;             
-    const float heightSensitivity = 200.0f;
     float particleCloudGravParameterScale = 2.0f;
+    particles.SelfGravityScale = particleCloudGravParameterScale;
+    particles.OpeningAngle = 0.5f;
+    configureParticles(particles, options);
+
+    SnapshotWriter recorder;
+    if (!openRecording(recorder, options))
+        return -1;
+    BodyRegistry bodies;
+    BodyHandle sphere;
+    if (!setupBodies(bodies, sphere, options))
+        return -1;
+    uint64_t simulationStep = 0;
+    double simulationTime = 0.0;
+    float simulationAccumulator = 0.0f;
 
     while (!glfwWindowShouldClose(window))
     {
+        PROFILE_SCOPE("Frame");
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        PROFILE_TIMER(inputTimer, "Input");
         processInput(window);
-
-        float dynamicSphereParameter = baseSphereParameter - (objectPos.y - baseSphereY) * heightSensitivity;
-        dynamicSphereParameter = std::max(0.0f, dynamicSphereParameter);
-
-        //gravity logic here
-        std::vector<GravitationalBody> allBodies;
-        allBodies.push_back(GravitationalBody{ objectPos, dynamicSphereParameter }); 
-
-        if (particles.TotalMass > 0.1f) {
-            float cloudGravParameter = particles.TotalMass * particleCloudGravParameterScale;
-            allBodies.push_back(GravitationalBody{ particles.CenterOfMass, cloudGravParameter }); 
+        PROFILE_STOP(inputTimer);
+
+        if (replaying) {
+            // P pauses, the arrows step one frame at a time
+            if (!replayPaused) {
+                replayElapsed += deltaTime;
+                replayFrame = replay.Advance(replayFrame, replayElapsed);
+            }
+            if (replayStepRequest != 0) {
+                unsigned int count = replay.FrameCount();
+                replayFrame = (replayFrame + count + replayStepRequest) % count;
+                replayStepRequest = 0;
+            }
+            if (replayFrame != loadedFrame) {
+                loadedFrame = replayFrame;
+                if (!replay.ReadFrame(replayFrame, frame)) {
+                    std::cerr << "AVISO::SNAPSHOT: quadro corrompido, pulado: " << replayFrame << std::endl;
+                    frame = SnapshotFrame();
+                } else if (frame.GridHeights && frame.GridColumns == gridSize() + 1 && frame.GridRows == gridSize() + 1) {
+                    // heights only when the recording used this grid's dimensions
+                    PROFILE_SCOPE("GridUpload");
+                    glBindBuffer(GL_ARRAY_BUFFER, replayHeightVBO);
+                    glBufferSubData(GL_ARRAY_BUFFER, 0, (size_t)frame.GridColumns * frame.GridRows * sizeof(float), frame.GridHeights);
+                }
+            }
+            if (frame.BodyCount > 0)
+                objectPos = glm::vec3(frame.Bodies[0], frame.Bodies[1], frame.Bodies[2]);
+        } else {
+            PROFILE_SCOPE("Simulation");
+            simulationAccumulator += std::min(deltaTime, MAX_FRAME_TIME);
+            unsigned int stepsThisFrame = 0;
+            placeSphere(bodies, sphere, objectPos);
+            while (simulationAccumulator >= options.TimeStep && stepsThisFrame < MAX_STEPS_PER_FRAME) {
+                stepSimulation(particles, bodies, objectPos, options.TimeStep);
+                simulationAccumulator -= options.TimeStep;
+                stepsThisFrame++;
+                simulationStep++;
+                simulationTime += options.TimeStep;
+                if (simulationStep % options.RecordEvery == 0)
+                    recordFrame(recorder, particles, bodies, gridVertices, simulationStep, simulationTime);
+            }
+            // too far behind: let the simulation run slow rather than spiral
+            if (stepsThisFrame == MAX_STEPS_PER_FRAME)
+                simulationAccumulator = std::min(simulationAccumulator, options.TimeStep);
+
+            // the CPU grid is still needed for the recording when another path draws
+            if ((!(gpuGridEnabled || options.LodGrid) || recorder.IsOpen()) && deformGrid(bodies, gridVertices, targetGridVertices))
+                gridUploadPending = true;
+            if (options.LodGrid && !gpuGridEnabled) {
+                bool resized = false;
+                if (deformLodGrid(bodies, lodGrid, resized))
+                    lodUploadPending = true;
+                lodResized = lodResized || resized;
+            }
+            if (gpuGridEnabled) {
+                if (!gpuGridWasEnabled) gridDisplacement.Reset(bodies);
+                else gridDisplacement.Update(bodies, GRID_SMOOTHING_FACTOR);
+            }
+            gpuGridWasEnabled = gpuGridEnabled;
         }
 
-        particles.Update(deltaTime, allBodies, 10, objectPos);
-        calculateTargetDeformation(targetGridVertices, allBodies);
-
-        for (size_t i = 0; i < gridVertices.size(); i += 3) {
-            float currentY = gridVertices[i + 1];
-            float targetY = targetGridVertices[i + 1];
-            gridVertices[i + 1] += (targetY - currentY) * GRID_SMOOTHING_FACTOR;
+        // replays always carry their own heights
+        const bool drawGpuGrid = gpuGridEnabled && !replaying;
+        const bool drawLodGrid = options.LodGrid && !drawGpuGrid && !replaying;
+        // a settled grid is already on the GPU
+        if (drawLodGrid && lodUploadPending) {
+            PROFILE_SCOPE("GridUpload");
+            const std::vector<float>& vertices = lodGrid.Vertices();
+            glBindVertexArray(lodVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, lodVBO);
+            if (vertices.size() > lodVertexCapacity) {
+                lodVertexCapacity = vertices.size() + vertices.size() / 2;
+                glBufferData(GL_ARRAY_BUFFER, lodVertexCapacity * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+            }
+            glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), vertices.data());
+            if (lodResized) {
+                const std::vector<unsigned int>& lines = lodGrid.Lines();
+                if (lines.size() > lodLineCapacity) {
+                    lodLineCapacity = lines.size() + lines.size() / 2;
+                    glBufferData(GL_ELEMENT_ARRAY_BUFFER, lodLineCapacity * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW);
+                }
+                glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, lines.size() * sizeof(unsigned int), lines.data());
+                lodResized = false;
+            }
+            lodUploadPending = false;
+        }
+        if (!drawGpuGrid && !drawLodGrid && gridUploadPending) {
+            PROFILE_SCOPE("GridUpload");
+            glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, gridVertices.size() * sizeof(float), gridVertices.data());
+            gridUploadPending = false;
         }
 
-        glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, gridVertices.size() * sizeof(float), gridVertices.data());
+        if (framebufferResized) {
+            effects.Resize(framebufferWidth, framebufferHeight);
+            framebufferResized = false;
+        }
 
+        gpuProfiler.Begin("Gpu.Frame");
         effects.BeginRender();
         cameraFront = glm::normalize(cameraFront);
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 200.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)effects.SceneWidth() / (float)effects.SceneHeight(), 0.1f, 200.0f);
         glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
         glm::mat4 model = glm::translate(glm::mat4(1.0f), objectPos);
+        frameUniforms.Update(view, projection, cameraPos);
         
-        glUseProgram(sphereShader);
-        glUniformMatrix4fv(glGetUniformLocation(sphereShader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(sphereShader, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(sphereShader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-        glUniform3fv(glGetUniformLocation(sphereShader, "objectColor"), 1, glm::value_ptr(glm::vec3(0.8f, 0.8f, 0.9f)));
-        glUniform3fv(glGetUniformLocation(sphereShader, "lightColor"), 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
-        glUniform3fv(glGetUniformLocation(sphereShader, "lightPos"), 1, glm::value_ptr(glm::vec3(5.0f, 10.0f, 5.0f)));
-        glUniform3fv(glGetUniformLocation(sphereShader, "viewPos"), 1, glm::value_ptr(cameraPos));
+        PROFILE_TIMER(drawTimer, "Draw.Sphere");
+        gpuProfiler.Begin("Gpu.Sphere");
+        sphereShader.Use();
+        glUniformMatrix4fv(sphereModel, 1, GL_FALSE, glm::value_ptr(model));
         glBindVertexArray(sphereVAO);
         glDrawElements(GL_TRIANGLES, sphereIndices.size(), GL_UNSIGNED_INT, 0);
-
-        glUseProgram(gridShader);
-        glUniformMatrix4fv(glGetUniformLocation(gridShader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(glGetUniformLocation(gridShader, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        model = glm::mat4(1.0f);
-        glUniformMatrix4fv(glGetUniformLocation(gridShader, "model"), 1, GL_FALSE, glm::value_ptr(model));
-        glBindVertexArray(gridVAO);
-        glDrawElements(GL_LINES, gridIndices.size(), GL_UNSIGNED_INT, 0);
+        gpuProfiler.End();
+        PROFILE_STOP(drawTimer);
+
+        PROFILE_TIMER(gridDrawTimer, "Draw.Grid");
+        gpuProfiler.Begin("Gpu.Grid");
+        if (drawGpuGrid)
+            gridGpuShader.Use();
+        else
+            gridShader.Use();
+        if (drawLodGrid) {
+            glBindVertexArray(lodVAO);
+            glDrawElements(GL_LINES, lodGrid.Lines().size(), GL_UNSIGNED_INT, 0);
+        }
+        else {
+            glBindVertexArray(replaying ? replayVAO : drawGpuGrid ? latticeVAO : gridVAO);
+            glDrawElements(GL_LINES, gridIndices.size(), GL_UNSIGNED_INT, 0);
+        }
+        gpuProfiler.End();
+        PROFILE_STOP(gridDrawTimer);
 
         // render particles
-        particles.Render(view, projection);
+        PROFILE_TIMER(particleDrawTimer, "Draw.Particles");
+        gpuProfiler.Begin("Gpu.Particles");
+        if (replaying) {
+            particles.RenderFrame(frame);
+            particles.RenderFrameBodies(frame, 1);
+        } else {
+            particles.Render();
+            // body 0 is the sphere, already drawn as a mesh
+            particles.RenderBodies(bodies, 1);
+        }
+        gpuProfiler.End();
+        PROFILE_STOP(particleDrawTimer);
 
         effects.EndRender();
-        effects.ProcessBloom(); 
+        if (bloomEnabled) {
+            PROFILE_SCOPE("Bloom");
+            ScopedGpuTimer bloomGpuTimer(gpuProfiler, "Gpu.Bloom");
+            effects.ProcessBloom();
+        }
 
         model = glm::translate(glm::mat4(1.0f), objectPos);
         glm::vec4 clipSpacePos = projection * view * model * glm::vec4(0.0, 0.0, 0.0, 1.0);
         glm::vec3 ndcSpacePos = glm::vec3(clipSpacePos) / clipSpacePos.w;
         glm::vec2 screenPos = (glm::vec2(ndcSpacePos.x, ndcSpacePos.y) + 1.0f) / 2.0f;
 
+        PROFILE_TIMER(finalTimer, "FinalPass");
+        gpuProfiler.Begin("Gpu.FinalPass");
         effects.RenderFinalScene(bloomEnabled);
+        gpuProfiler.End();
+        gpuProfiler.End(); // Gpu.Frame
+        PROFILE_STOP(finalTimer);
 
+        PROFILE_TIMER(swapTimer, "Swap");
         glfwSwapBuffers(window);
+        PROFILE_STOP(swapTimer);
+        gpuProfiler.EndFrame();
         glfwPollEvents();
+
+        // rolling p50/p99 in the title; the GPU figures trail by a few frames
+        if (Profiler::Enabled() && currentFrame - lastOverlayUpdate >= PROFILE_OVERLAY_INTERVAL) {
+            ProfileStats cpu = Profiler::Stats("Frame");
+            ProfileStats gpu = Profiler::Stats("Gpu.Frame", 240, PROFILER_GPU_TRACK);
+            char overlay[128];
+            std::snprintf(overlay, sizeof(overlay), " [CPU p50 %.2f p99 %.2f ms | GPU p50 %.2f p99 %.2f ms]",
+                          cpu.P50, cpu.P99, gpu.P50, gpu.P99);
+            profileOverlay = overlay;
+            glfwSetWindowTitle(window, windowTitle().c_str());
+            lastOverlayUpdate = currentFrame;
+        }
     }
 
+    closeRecording(recorder);
+    if (!options.TracePath.empty())
+        Profiler::WriteChromeTrace(options.TracePath);
+
     glDeleteVertexArrays(1, &gridVAO);
+    glDeleteVertexArrays(1, &latticeVAO);
+    glDeleteBuffers(1, &latticeVBO);
+    glDeleteVertexArrays(1, &replayVAO);
+    glDeleteBuffers(1, &replayHeightVBO);
+    glDeleteVertexArrays(1, &lodVAO);
+    glDeleteBuffers(1, &lodVBO);
+    glDeleteBuffers(1, &lodEBO);
     glDeleteVertexArrays(1, &sphereVAO);
     glDeleteBuffers(1, &gridVBO);
     glDeleteBuffers(1, &sphereVBO);
     glDeleteBuffers(1, &gridEBO);
     glDeleteBuffers(1, &sphereEBO);
-    glDeleteProgram(gridShader);
-    glDeleteProgram(sphereShader);
-    glDeleteProgram(postProcessShader);
-
-    glfwTerminate();
     return 0;
 }
 
+std::string windowTitle() {
+    std::string title = "Simulador de Gravidade [Velocidade: " + speedNames[currentSpeedIndex] + "]";
+    if (gpuGridEnabled)
+        title += " [Malha: GPU]";
+    return title + profileOverlay;
+}
+
 void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
@@ -245,11 +508,34 @@ void processInput(GLFWwindow *window) {
     bool v_key_is_down = glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS;
     if (v_key_is_down && !v_key_pressed_last_frame) {
         currentSpeedIndex = (currentSpeedIndex + 1) % speedNames.size();
-        std::string newTitle = "Simulador de Gravidade [Velocidade: " + speedNames[currentSpeedIndex] + "]";
-        glfwSetWindowTitle(window, newTitle.c_str());
+        glfwSetWindowTitle(window, windowTitle().c_str());
     }
     v_key_pressed_last_frame = v_key_is_down;
 
+    bool g_key_is_down = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (g_key_is_down && !g_key_pressed_last_frame) {
+        gpuGridEnabled = !gpuGridEnabled;
+        glfwSetWindowTitle(window, windowTitle().c_str());
+    }
+    g_key_pressed_last_frame = g_key_is_down;
+
+    bool b_key_is_down = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+    if (b_key_is_down && !b_key_pressed_last_frame)
+        bloomEnabled = !bloomEnabled;
+    b_key_pressed_last_frame = b_key_is_down;
+
+    bool p_key_is_down = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (p_key_is_down && !p_key_pressed_last_frame)
+        replayPaused = !replayPaused;
+    p_key_pressed_last_frame = p_key_is_down;
+
+    bool left_key_is_down = glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS;
+    bool right_key_is_down = glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS;
+    if (left_key_is_down && !left_key_pressed_last_frame) replayStepRequest--;
+    if (right_key_is_down && !right_key_pressed_last_frame) replayStepRequest++;
+    left_key_pressed_last_frame = left_key_is_down;
+    right_key_pressed_last_frame = right_key_is_down;
+
     float speed = horizontalSpeedSettings[currentSpeedIndex];
     float verticalSpeed = verticalSpeedSettings[currentSpeedIndex];
 
@@ -315,30 +601,9 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
     last_mouse_y = ypos;
 }
 
-void calculateTargetDeformation(std::vector<float>& targetVertices, const std::vector<GravitationalBody>& allBodies) {
-    for (size_t i = 0; i < targetVertices.size(); i += 3) {
-        int vertexIndex = i / 3;
-        int col = vertexIndex % (GRID_SIZE + 1);
-        int row = vertexIndex / (GRID_SIZE + 1);
-
-        float x = (col - GRID_SIZE / 2.0f) * GRID_SCALE;
-        float z = (row - GRID_SIZE / 2.0f) * GRID_SCALE;
-        
-        float totalPotential = 0.0f;
-
-        for (const auto& body : allBodies)
-        {
-            float dx = x - body.Position.x;
-            float dz = z - body.Position.z;
-            float rSq = dx * dx + dz * dz;
-            
-            totalPotential += -body.GravitationalParameter / sqrt(rSq + SOFTENING_FACTOR * SOFTENING_FACTOR);
-        }
-        
-        targetVertices[i + 1] = totalPotential * VISUAL_SCALE;
-    }
-}
-
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
+    framebufferResized = true;
 }
@@ -0,0 +1,351 @@
+// microbenchmarks for the simulation's hot paths, run without a window or GL context.
+//   gravity_bench --benchmark_out=bench.json --benchmark_out_format=json
+// keeps a machine-readable record to compare across commits
+#include <benchmark/benchmark.h>
+#include <glm/glm.hpp>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "AdaptiveGrid.h"
+#include "BodyForce.h"
+#include "BodyRegistry.h"
+#include "Octree.h"
+#include "ParticleMesh.h"
+#include "ParticleSystem.h"
+#include "Physics.h"
+#include "PotentialField.h"
+#include "Simulation.h"
+#include "SpatialHash.h"
+
+const float BENCH_SPACING = 0.5f;
+const float BENCH_EXTENT = 20.0f;
+
+// count bodies on a ring around the origin sharing the sphere's usual strength
+static void makeBodies(BodyRegistry& bodies, unsigned int count)
+{
+    for (unsigned int b = 0; b < count; ++b) {
+        float angle = 6.2831853f * b / count;
+        float radius = count > 1 ? 6.0f : 0.0f;
+        bodies.Add(std::cos(angle) * radius, 1.0f, std::sin(angle) * radius, 400.0f / count);
+    }
+}
+
+// a loose cloud the size of the jets, filled into a ParticleStore
+static void fillCloud(ParticleStore& store, unsigned int count)
+{
+    std::mt19937 random(DEFAULT_PARTICLE_SEED);
+    std::uniform_real_distribution<float> spread(-BENCH_EXTENT * 0.25f, BENCH_EXTENT * 0.25f);
+    store.Resize(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int slot;
+        store.Spawn(slot);
+        store.PosX[slot] = spread(random);
+        store.PosY[slot] = spread(random) * 0.25f;
+        store.PosZ[slot] = spread(random);
+    }
+}
+
+// the grid the bodies bend: (resolution + 1)^2 vertices
+static void BM_PotentialField(benchmark::State& state)
+{
+    const unsigned int resolution = (unsigned int)state.range(0);
+    BodyRegistry bodies;
+    makeBodies(bodies, (unsigned int)state.range(1));
+    PotentialField field(resolution + 1, resolution + 1, -BENCH_EXTENT, -BENCH_EXTENT, 2.0f * BENCH_EXTENT / resolution);
+    std::vector<float> heights(field.VertexCount());
+
+    for (auto _ : state) {
+        field.Evaluate(bodies.PosX.data(), bodies.PosZ.data(), bodies.GM.data(), bodies.Count,
+                       SOFTENING_FACTOR, VISUAL_SCALE, heights.data());
+        benchmark::DoNotOptimize(heights.data());
+    }
+    state.SetItemsProcessed(state.iterations() * field.VertexCount());
+}
+BENCHMARK(BM_PotentialField)->ArgsProduct({ { 50, 100, 200 }, { 1, 8, 32 } });
+
+static void BM_PotentialGradient(benchmark::State& state)
+{
+    const unsigned int resolution = (unsigned int)state.range(0);
+    BodyRegistry bodies;
+    makeBodies(bodies, (unsigned int)state.range(1));
+    PotentialField field(resolution + 1, resolution + 1, -BENCH_EXTENT, -BENCH_EXTENT, 2.0f * BENCH_EXTENT / resolution);
+    std::vector<float> gradX(field.VertexCount()), gradZ(field.VertexCount());
+
+    for (auto _ : state) {
+        field.EvaluateGradient(bodies.PosX.data(), bodies.PosZ.data(), bodies.GM.data(), bodies.Count,
+                               SOFTENING_FACTOR, VISUAL_SCALE, gradX.data(), gradZ.data());
+        benchmark::DoNotOptimize(gradX.data());
+        benchmark::DoNotOptimize(gradZ.data());
+    }
+    state.SetItemsProcessed(state.iterations() * field.VertexCount());
+}
+BENCHMARK(BM_PotentialGradient)->ArgsProduct({ { 50, 100, 200 }, { 1, 8, 32 } });
+
+// the window's grid at GRID_SIZE. the field is cached per registry version and
+// only refreshed around bodies that moved, so every body is nudged each iteration
+// to force a full evaluation
+static void BM_CalculateTargetDeformation(benchmark::State& state)
+{
+    BodyRegistry bodies;
+    makeBodies(bodies, (unsigned int)state.range(0));
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    buildGridMesh(vertices, indices);
+
+    float nudge = 1e-3f;
+    for (auto _ : state) {
+        for (unsigned int b = 0; b < bodies.Count; ++b)
+            bodies.PosX[b] += nudge;
+        bodies.Touch();
+        nudge = -nudge;
+        calculateTargetDeformation(vertices, bodies);
+        benchmark::DoNotOptimize(vertices.data());
+    }
+    state.SetItemsProcessed(state.iterations() * (GRID_SIZE + 1) * (GRID_SIZE + 1));
+}
+BENCHMARK(BM_CalculateTargetDeformation)->Arg(1)->Arg(8)->Arg(32);
+
+// the sphere circling among count pinned bodies: only the vertices near it are
+// re-evaluated, with a full pass whenever the far-field error runs out. 0 is the
+// sphere alone, where the patch has to beat one full single-body pass
+static void BM_GridFieldMovingBody(benchmark::State& state)
+{
+    BodyRegistry bodies;
+    BodyHandle sphere = bodies.Add(0.0f, 1.0f, 0.0f, 400.0f, 0.0f, 0.0f, 0.0f, true);
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> spread(-GRID_SIZE / 2.0f * GRID_SCALE, GRID_SIZE / 2.0f * GRID_SCALE);
+    for (int64_t b = 0; b < state.range(0); ++b)
+        bodies.Add(spread(random), 0.0f, spread(random), 5.0f, 0.0f, 0.0f, 0.0f, true);
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    buildGridMesh(vertices, indices);
+
+    float angle = 0.0f;
+    for (auto _ : state) {
+        angle += 0.01f;
+        bodies.Set(sphere, std::cos(angle) * 6.0f, 1.0f, std::sin(angle) * 6.0f, 400.0f);
+        calculateTargetDeformation(vertices, bodies);
+        benchmark::DoNotOptimize(vertices.data());
+    }
+    state.SetItemsProcessed(state.iterations() * (GRID_SIZE + 1) * (GRID_SIZE + 1));
+}
+BENCHMARK(BM_GridFieldMovingBody)->Arg(0)->Arg(64)->Arg(512)->Arg(2048);
+
+// --grid-lod with the sphere circling among count pinned bodies: the tree is only
+// refitted around the sphere's old and new spots
+static void BM_AdaptiveGridUpdate(benchmark::State& state)
+{
+    BodyRegistry bodies;
+    BodyHandle sphere = bodies.Add(0.0f, 1.0f, 0.0f, 400.0f, 0.0f, 0.0f, 0.0f, true);
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> spread(-GRID_SIZE / 2.0f * GRID_SCALE, GRID_SIZE / 2.0f * GRID_SCALE);
+    for (int64_t b = 0; b < state.range(0); ++b)
+        bodies.Add(spread(random), 0.0f, spread(random), 5.0f, 0.0f, 0.0f, 0.0f, true);
+    AdaptiveGrid grid(GRID_SIZE * GRID_SCALE, GRID_LOD_MIN_DEPTH, GRID_LOD_MAX_DEPTH);
+
+    float angle = 0.0f;
+    for (auto _ : state) {
+        angle += 0.01f;
+        bodies.Set(sphere, std::cos(angle) * 6.0f, 1.0f, std::sin(angle) * 6.0f, 400.0f);
+        bool resized = false;
+        deformLodGrid(bodies, grid, resized);
+        benchmark::DoNotOptimize(grid.Vertices().data());
+    }
+    state.SetItemsProcessed(state.iterations() * grid.VertexCount());
+    state.counters["vertices"] = (double)grid.VertexCount();
+}
+BENCHMARK(BM_AdaptiveGridUpdate)->Arg(0)->Arg(64);
+
+// target plus easing, what the VTK build's UpdateGridDeformation does each tick
+static void BM_DeformGrid(benchmark::State& state)
+{
+    BodyRegistry bodies;
+    makeBodies(bodies, (unsigned int)state.range(0));
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    buildGridMesh(vertices, indices);
+    std::vector<float> target = vertices;
+
+    float nudge = 1e-3f;
+    for (auto _ : state) {
+        for (unsigned int b = 0; b < bodies.Count; ++b)
+            bodies.PosX[b] += nudge;
+        bodies.Touch();
+        nudge = -nudge;
+        deformGrid(bodies, vertices, target);
+        benchmark::DoNotOptimize(vertices.data());
+    }
+    state.SetItemsProcessed(state.iterations() * (GRID_SIZE + 1) * (GRID_SIZE + 1));
+}
+BENCHMARK(BM_DeformGrid)->Arg(1)->Arg(8)->Arg(32);
+
+static void BM_BodyAcceleration(benchmark::State& state)
+{
+    ParticleStore store;
+    fillCloud(store, (unsigned int)state.range(0));
+    BodyRegistry bodies;
+    makeBodies(bodies, (unsigned int)state.range(1));
+    AlignedFloatArray ax(store.LiveCount), ay(store.LiveCount), az(store.LiveCount);
+
+    for (auto _ : state) {
+        accumulateBodyAcceleration(store.PosX.data(), store.PosY.data(), store.PosZ.data(), store.LiveCount,
+                                   bodies.PosX.data(), bodies.PosY.data(), bodies.PosZ.data(), bodies.GM.data(),
+                                   bodies.Count, SOFTENING_FACTOR, ax.data(), ay.data(), az.data());
+        benchmark::DoNotOptimize(ax.data());
+    }
+    state.SetItemsProcessed(state.iterations() * store.LiveCount * bodies.Count);
+    state.SetLabel(SimdLevelName(DetectSimdLevel()));
+}
+BENCHMARK(BM_BodyAcceleration)->ArgsProduct({ { 1000, 2000, 5500 }, { 1, 8, 32 } });
+
+// the per-particle glm loop the kernel replaced, kept as the baseline
+static void BM_BodyAccelerationGlm(benchmark::State& state)
+{
+    ParticleStore store;
+    fillCloud(store, (unsigned int)state.range(0));
+    BodyRegistry registry;
+    makeBodies(registry, (unsigned int)state.range(1));
+    std::vector<GravitationalBody> bodies;
+    for (unsigned int b = 0; b < registry.Count; ++b)
+        bodies.push_back(GravitationalBody{ glm::vec3(registry.PosX[b], registry.PosY[b], registry.PosZ[b]), registry.GM[b] });
+    std::vector<glm::vec3> accelerations(store.LiveCount);
+
+    for (auto _ : state) {
+        for (unsigned int i = 0; i < store.LiveCount; ++i) {
+            glm::vec3 position = store.Position(i);
+            glm::vec3 total(0.0f);
+            for (const auto& body : bodies) {
+                float distSq = glm::dot(body.Position - position, body.Position - position);
+                float magnitude = body.GravitationalParameter / (distSq + SOFTENING_FACTOR * SOFTENING_FACTOR);
+                total += glm::normalize(body.Position - position) * magnitude;
+            }
+            accelerations[i] = total;
+        }
+        benchmark::DoNotOptimize(accelerations.data());
+    }
+    state.SetItemsProcessed(state.iterations() * store.LiveCount * bodies.size());
+}
+BENCHMARK(BM_BodyAccelerationGlm)->ArgsProduct({ { 1000, 2000, 5500 }, { 1, 8, 32 } });
+
+// one mutual step of a scene's free bodies, O(bodies^2) pairs
+static void BM_BodyRegistryStep(benchmark::State& state)
+{
+    const unsigned int count = (unsigned int)state.range(0);
+    BodyRegistry bodies;
+    makeBodies(bodies, count);
+    ThreadPool workers;
+
+    for (auto _ : state)
+        bodies.Step(1e-5f, SOFTENING_FACTOR, &workers);
+    state.SetItemsProcessed(state.iterations() * count * count);
+    state.counters["threads"] = (double)workers.ThreadCount();
+}
+BENCHMARK(BM_BodyRegistryStep)->Arg(256)->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond);
+
+static void BM_SpatialHashBuild(benchmark::State& state)
+{
+    ParticleStore store;
+    fillCloud(store, (unsigned int)state.range(0));
+    SpatialHash grid(0.5f);
+
+    for (auto _ : state)
+        grid.Build(store);
+    state.SetItemsProcessed(state.iterations() * store.LiveCount);
+}
+BENCHMARK(BM_SpatialHashBuild)->Arg(1000)->Arg(2000)->Arg(5500);
+
+static void BM_OctreeBuild(benchmark::State& state)
+{
+    ParticleStore store;
+    fillCloud(store, (unsigned int)state.range(0));
+    Octree tree;
+
+    for (auto _ : state)
+        tree.Build(store.PosX.data(), store.PosY.data(), store.PosZ.data(), store.Mass.data(), store.LiveCount);
+    state.SetItemsProcessed(state.iterations() * store.LiveCount);
+}
+BENCHMARK(BM_OctreeBuild)->Arg(1000)->Arg(2000)->Arg(5500);
+
+// one Barnes-Hut query per particle
+static void BM_OctreeField(benchmark::State& state)
+{
+    ParticleStore store;
+    fillCloud(store, (unsigned int)state.range(0));
+    Octree tree;
+    tree.Build(store.PosX.data(), store.PosY.data(), store.PosZ.data(), store.Mass.data(), store.LiveCount);
+
+    for (auto _ : state) {
+        glm::vec3 sum(0.0f);
+        for (unsigned int i = 0; i < store.LiveCount; ++i)
+            sum += tree.Field(store.Position(i), 0.5f, SOFTENING_FACTOR);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * store.LiveCount);
+}
+BENCHMARK(BM_OctreeField)->Arg(1000)->Arg(2000)->Arg(5500);
+
+// the particle-mesh alternative to the tree and the body sum: deposit the cloud,
+// solve the window's lattice and read every particle's acceleration back
+static void BM_ParticleMesh(benchmark::State& state)
+{
+    ParticleStore store;
+    fillCloud(store, (unsigned int)state.range(0));
+    PotentialField lattice(GRID_SIZE + 1, GRID_SIZE + 1, -GRID_SIZE / 2.0f * GRID_SCALE, -GRID_SIZE / 2.0f * GRID_SCALE, GRID_SCALE);
+    ParticleMesh mesh(lattice, SOFTENING_FACTOR);
+
+    for (auto _ : state) {
+        mesh.Clear();
+        mesh.Deposit(store.PosX.data(), store.PosY.data(), store.PosZ.data(), store.Mass.data(), store.LiveCount);
+        mesh.Solve();
+        float sum = 0.0f;
+        for (unsigned int i = 0; i < store.LiveCount; ++i) {
+            float ax, ay, az;
+            mesh.Acceleration(store.PosX[i], store.PosY[i], store.PosZ[i], ax, ay, az);
+            sum += ax + ay + az;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * store.LiveCount);
+}
+BENCHMARK(BM_ParticleMesh)->Arg(1000)->Arg(2000)->Arg(5500)->Unit(benchmark::kMillisecond);
+
+// jet spawning: the rng draw and the store writes for each new particle
+static void BM_Spawn(benchmark::State& state)
+{
+    const unsigned int count = (unsigned int)state.range(0);
+    ParticleSystem particles(0, count, 1);
+
+    for (auto _ : state) {
+        particles.Clear();
+        particles.Spawn(count, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_Spawn)->Arg(10)->Arg(1000)->Arg(5500);
+
+// one whole particle step: SPH density and force passes over the neighbour grid,
+// the body pull and the integration. the cloud is spread by a few real steps
+// first, then stepped with a tiny dt so its shape holds for every iteration
+static void BM_ParticleStep(benchmark::State& state)
+{
+    const unsigned int count = (unsigned int)state.range(0);
+    BodyRegistry bodies;
+    makeBodies(bodies, (unsigned int)state.range(1));
+    const bool selfGravity = state.range(2) != 0;
+
+    ParticleSystem particles(0, count);
+    particles.SelfGravity = selfGravity;
+    particles.Scheme = Integrator::Euler;
+    particles.Substeps.MaxSubsteps = 1;
+    particles.Spawn(count, glm::vec3(0.0f, 1.0f, 0.0f));
+    for (int warmup = 0; warmup < 20; ++warmup)
+        particles.Update(1.0f / 60.0f, bodies, 0, glm::vec3(0.0f, 1.0f, 0.0f));
+
+    for (auto _ : state)
+        particles.Update(1e-5f, bodies, 0, glm::vec3(0.0f, 1.0f, 0.0f));
+    state.SetItemsProcessed(state.iterations() * particles.LiveCount());
+    state.counters["threads"] = (double)particles.ThreadCount();
+}
+BENCHMARK(BM_ParticleStep)->ArgsProduct({ { 1000, 2000, 5500 }, { 1, 32 }, { 0, 1 } })->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -8,13 +8,37 @@
 #include <vtkSmartPointer.h>
 #include <vtkSphereSource.h>
 #include <vtkProperty.h>
-#include <vtkWarpScalar.h>
-#include <vtkDoubleArray.h>
-#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkFloatArray.h>
 #include <vtkCommand.h>
+#include <vtkCellArray.h>
+#include <vtkPointData.h>
+#include <vtkSOADataArrayTemplate.h>
+#include <vtkUnsignedCharArray.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include "PotentialField.h"
+#include "AdaptiveGrid.h"
+#include "SnapshotReader.h"
+#include "BodyRegistry.h"
+#include "Scene.h"
+#include "ThreadPool.h"
 
 const float VISUAL_SCALE = 0.01f;
 const float SOFTENING_FACTOR = 0.5f;
+const int GRID_RESOLUTION = 100;
+const float GRID_EXTENT = 50.0f;
+// --grid-lod cells run from 2 * GRID_EXTENT / 2^3 down to / 2^9
+const unsigned int GRID_LOD_MIN_DEPTH = 3;
+const unsigned int GRID_LOD_MAX_DEPTH = 9;
+// simulated seconds per timer tick, for the bodies' mutual gravity
+const float BODY_TIME_STEP = 1.0f / 60.0f;
 
 class vtkTimerCallback : public vtkCommand
 {
@@ -24,53 +48,344 @@ public:
     }
 
     void Execute(vtkObject* caller, unsigned long eventId, void* callData) override {
+        this->Advance();
+
+        vtkRenderWindowInteractor* iren = static_cast<vtkRenderWindowInteractor*>(caller);
+        iren->GetRenderWindow()->Render();
+    }
+
+    // one tick of the orbit, the scene bodies and the grid, without rendering
+    void Advance() {
         double time = this->TimerCount * 0.1;
         this->SphereActor->SetPosition(cos(time) * 10.0, 1.0, sin(time) * 10.0);
+        this->PlaceSphere();
+        this->Bodies.Step(BODY_TIME_STEP, SOFTENING_FACTOR, &this->Workers);
         
         this->UpdateGridDeformation();
-
-        vtkRenderWindowInteractor* iren = static_cast<vtkRenderWindowInteractor*>(caller);
-        iren->GetRenderWindow()->Render();
+        this->UpdateBodyPoints();
         this->TimerCount++;
     }
 
-    void UpdateGridDeformation() {
+    // the sphere is body 0, pinned to the actor
+    void PlaceSphere() {
         double spherePos[3];
         this->SphereActor->GetPosition(spherePos);
+        if (!this->Bodies.Valid(this->Sphere))
+            this->Sphere = this->Bodies.Add(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, true);
+        this->Bodies.Set(this->Sphere, (float)spherePos[0], (float)spherePos[1], (float)spherePos[2], this->GravitationalParameter);
+    }
 
-        vtkPolyData* planeData = static_cast<vtkPolyData*>(this->PlaneSource->GetOutput());
-        vtkSmartPointer<vtkDoubleArray> scalars = vtkSmartPointer<vtkDoubleArray>::New();
-        scalars->SetNumberOfComponents(1);
-        scalars->SetName("DeformationScalars");
+    // the scene bodies as vertices whose point arrays are the registry's own
+    void SetBodyPoints(vtkPolyData* bodyData) {
+        this->BodyData = bodyData;
+        this->BodyPoints->SetNumberOfComponents(3);
+        vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+        points->SetData(this->BodyPoints);
+        bodyData->SetPoints(points);
+        bodyData->SetVerts(this->BodyCells);
+        this->UpdateBodyPoints();
+    }
 
-        for (vtkIdType i = 0; i < planeData->GetNumberOfPoints(); i++)
-        {
-            double p[3];
-            planeData->GetPoint(i, p);
+    void UpdateBodyPoints() {
+        if (!this->BodyData) return;
+        vtkIdType count = this->Bodies.Count;
+        this->BodyPoints->SetArray(0, this->Bodies.PosX.data(), count, true, true);
+        this->BodyPoints->SetArray(1, this->Bodies.PosY.data(), count, true, true);
+        this->BodyPoints->SetArray(2, this->Bodies.PosZ.data(), count, true, true);
+        this->BodyPoints->Modified();
+        this->BodyData->GetPoints()->Modified();
+
+        // body 0 is the sphere, drawn by its own actor
+        if (count - 1 != this->BodyCells->GetNumberOfCells()) {
+            this->BodyCells->Reset();
+            for (vtkIdType i = 1; i < count; ++i)
+                this->BodyCells->InsertNextCell(1, &i);
+            this->BodyCells->Modified();
+        }
+        this->BodyData->Modified();
+    }
 
-            float dx = p[0] - spherePos[0];
-            float dz = p[2] - spherePos[2];
-            float rSq = dx * dx + dz * dz;
+    // grid must hold single-precision points laid out like Field (x fastest, then z).
+    // the y of each point is rewritten in place every tick, no filter involved
+    void SetGrid(vtkPolyData* grid) {
+        this->GridData = grid;
+        this->GridPoints = vtkFloatArray::SafeDownCast(grid->GetPoints()->GetData())->GetPointer(0);
+        this->Heights.assign(this->Field.VertexCount(), 0.0f);
+    }
 
-            double potential = -this->GravitationalParameter / sqrt(rSq + SOFTENING_FACTOR * SOFTENING_FACTOR);
-            scalars->InsertNextValue(potential);
+    // --grid-lod: the grid becomes the adaptive grid's lines, its points the grid's
+    // own vertex array. call after SetGrid
+    void UseAdaptiveGrid() {
+        this->Lod.reset(new AdaptiveGrid(2.0f * GRID_EXTENT, GRID_LOD_MIN_DEPTH, GRID_LOD_MAX_DEPTH));
+        this->LodPoints->SetNumberOfComponents(3);
+        vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+        points->SetData(this->LodPoints);
+        this->GridData->SetPoints(points);
+        this->GridData->SetPolys(nullptr);
+        this->GridPoints = nullptr;
+    }
+
+    // nothing to redo while the bodies stand still
+    void UpdateGridDeformation() {
+        if (this->FieldVersion == this->Bodies.Version())
+            return;
+        this->FieldVersion = this->Bodies.Version();
+        if (this->Lod) {
+            this->UpdateAdaptiveGrid();
+            return;
         }
+        this->Field.Evaluate(this->Bodies.PosX.data(), this->Bodies.PosZ.data(), this->Bodies.GM.data(), this->Bodies.Count,
+                             SOFTENING_FACTOR, VISUAL_SCALE, this->Heights.data());
+
+        float* y = this->GridPoints + 1;
+        for (size_t i = 0; i < this->Heights.size(); i++)
+            y[i * 3] = this->Heights[i];
+
+        this->GridData->GetPoints()->Modified();
+    }
 
-        planeData->GetPointData()->SetScalars(scalars);
-        this->WarpFilter->Update();
+    // the heights go straight to the targets, no easing; the cells are only
+    // handed to VTK again when they changed
+    void UpdateAdaptiveGrid() {
+        bool resized = this->Lod->Update(this->Bodies, SOFTENING_FACTOR, VISUAL_SCALE);
+        this->Lod->Ease(1.0f);
+        const std::vector<float>& vertices = this->Lod->Vertices();
+        if (resized || this->LodPoints->GetPointer(0) != vertices.data()) {
+            this->LodPoints->SetArray(const_cast<float*>(vertices.data()), (vtkIdType)vertices.size(), 1);
+            vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+            const std::vector<unsigned int>& lines = this->Lod->Lines();
+            for (size_t i = 0; i < lines.size(); i += 2) {
+                vtkIdType ends[2] = { lines[i], lines[i + 1] };
+                cells->InsertNextCell(2, ends);
+            }
+            this->GridData->SetLines(cells);
+        }
+        this->LodPoints->Modified();
+        this->GridData->GetPoints()->Modified();
+        this->GridData->Modified();
     }
 
     vtkActor* SphereActor;
-    vtkPlaneSource* PlaneSource;
-    vtkWarpScalar* WarpFilter;
     float GravitationalParameter;
+    BodyRegistry Bodies;
+    BodyHandle Sphere;
 
 private:
     int TimerCount = 0;
+    ThreadPool Workers;
+    vtkPolyData* BodyData = nullptr;
+    vtkSmartPointer<vtkSOADataArrayTemplate<float>> BodyPoints = vtkSmartPointer<vtkSOADataArrayTemplate<float>>::New();
+    vtkSmartPointer<vtkCellArray> BodyCells = vtkSmartPointer<vtkCellArray>::New();
+    PotentialField Field{ GRID_RESOLUTION + 1, GRID_RESOLUTION + 1, -GRID_EXTENT, -GRID_EXTENT, 2.0f * GRID_EXTENT / GRID_RESOLUTION };
+    std::vector<float> Heights;
+    uint64_t FieldVersion = UINT64_MAX;
+    vtkPolyData* GridData = nullptr;
+    float* GridPoints = nullptr;
+    std::unique_ptr<AdaptiveGrid> Lod;
+    vtkSmartPointer<vtkFloatArray> LodPoints = vtkSmartPointer<vtkFloatArray>::New();
 };
 
-int main(int, char*[])
+// --replay PATH: plays a run recorded by the OpenGL build instead of computing the
+// grid. particle positions and grid heights are structure-of-arrays VTK arrays
+// whose components point straight into the mapped file, so a tick costs a seek
+// and a render
+class vtkReplayCallback : public vtkCommand
 {
+public:
+    static vtkReplayCallback* New() {
+        return new vtkReplayCallback;
+    }
+
+    void Execute(vtkObject* caller, unsigned long eventId, void* callData) override {
+        this->Elapsed += 1.0 / 60.0;
+        this->ShowFrame(this->Replay.Advance(this->Frame, this->Elapsed));
+
+        vtkRenderWindowInteractor* iren = static_cast<vtkRenderWindowInteractor*>(caller);
+        iren->GetRenderWindow()->Render();
+    }
+
+    bool Open(const std::string& path, unsigned int firstFrame) {
+        if (!this->Replay.Open(path)) return false;
+        if (this->Replay.FrameCount() == 0) {
+            std::cerr << "ERRO::SNAPSHOT: gravacao sem quadros: " << path << std::endl;
+            return false;
+        }
+        this->Frame = std::min(firstFrame, this->Replay.FrameCount() - 1);
+        return true;
+    }
+
+    // grid keeps its cells; its points are swapped for x/z lattice arrays plus
+    // the recorded heights as y
+    void SetScene(vtkPolyData* grid, vtkPolyData* particles, vtkActor* sphere) {
+        this->GridData = grid;
+        this->ParticleData = particles;
+        this->SphereActor = sphere;
+
+        vtkPoints* lattice = grid->GetPoints();
+        this->GridX.resize(lattice->GetNumberOfPoints());
+        this->GridZ.resize(lattice->GetNumberOfPoints());
+        for (vtkIdType i = 0; i < lattice->GetNumberOfPoints(); ++i) {
+            double p[3];
+            lattice->GetPoint(i, p);
+            this->GridX[i] = (float)p[0];
+            this->GridZ[i] = (float)p[2];
+        }
+        this->GridFlat.assign(this->GridX.size(), 0.0f);
+
+        this->GridPoints->SetNumberOfComponents(3);
+        vtkSmartPointer<vtkPoints> gridPoints = vtkSmartPointer<vtkPoints>::New();
+        gridPoints->SetData(this->GridPoints);
+        grid->SetPoints(gridPoints);
+
+        this->ParticlePoints->SetNumberOfComponents(3);
+        vtkSmartPointer<vtkPoints> particlePoints = vtkSmartPointer<vtkPoints>::New();
+        particlePoints->SetData(this->ParticlePoints);
+        particles->SetPoints(particlePoints);
+        particles->SetVerts(this->ParticleCells);
+
+        this->ParticleColors->SetNumberOfComponents(4);
+        particles->GetPointData()->SetScalars(this->ParticleColors);
+    }
+
+    void ShowFrame(unsigned int index) {
+        this->Frame = index;
+        SnapshotFrame frame;
+        if (!this->Replay.ReadFrame(index, frame)) return;
+
+        if (frame.BodyCount > 0)
+            this->SphereActor->SetPosition(frame.Bodies[0], frame.Bodies[1], frame.Bodies[2]);
+
+        // the recorded lattice replaces the VTK plane's when the dimensions agree
+        const float* heights = this->GridFlat.data();
+        vtkIdType gridCount = (vtkIdType)this->GridX.size();
+        if (frame.GridHeights && (vtkIdType)frame.GridColumns * frame.GridRows == gridCount) {
+            heights = frame.GridHeights;
+            if (frame.GridSpacing > 0.0f && frame.GridSpacing != this->LatticeSpacing) {
+                for (vtkIdType i = 0; i < gridCount; ++i) {
+                    this->GridX[i] = frame.GridOriginX + (i % frame.GridColumns) * frame.GridSpacing;
+                    this->GridZ[i] = frame.GridOriginZ + (i / frame.GridColumns) * frame.GridSpacing;
+                }
+                this->LatticeSpacing = frame.GridSpacing;
+            }
+        }
+        this->GridPoints->SetArray(0, this->GridX.data(), gridCount, true, true);
+        this->GridPoints->SetArray(1, const_cast<float*>(heights), gridCount, true, true);
+        this->GridPoints->SetArray(2, this->GridZ.data(), gridCount, true, true);
+        this->GridPoints->Modified();
+        this->GridData->GetPoints()->Modified();
+
+        vtkIdType count = frame.ParticleCount;
+        if (count > 0) {
+            this->ParticlePoints->SetArray(0, const_cast<float*>(frame.PosX), count, true, true);
+            this->ParticlePoints->SetArray(1, const_cast<float*>(frame.PosY), count, true, true);
+            this->ParticlePoints->SetArray(2, const_cast<float*>(frame.PosZ), count, true, true);
+        } else {
+            for (int c = 0; c < 3; ++c)
+                this->ParticlePoints->SetArray(c, this->GridFlat.data(), 0, true, true);
+        }
+        this->ParticlePoints->Modified();
+        this->ParticleData->GetPoints()->Modified();
+
+        if (count != this->ParticleCells->GetNumberOfCells()) {
+            this->ParticleCells->Reset();
+            for (vtkIdType i = 0; i < count; ++i)
+                this->ParticleCells->InsertNextCell(1, &i);
+            this->ParticleCells->Modified();
+        }
+
+        // same scheme as the OpenGL build: jet colour from the sign of vx, alpha from life
+        this->ParticleColors->SetNumberOfTuples(count);
+        for (vtkIdType i = 0; i < count; ++i) {
+            bool leftJet = frame.VelX && frame.VelX[i] < 0.0f;
+            float life = frame.Life ? std::min(frame.Life[i] / 8.0f, 1.0f) : 1.0f;
+            unsigned char rgba[4] = { (unsigned char)(leftJet ? 51 : 255), (unsigned char)(leftJet ? 128 : 51),
+                                      (unsigned char)(leftJet ? 255 : 51), (unsigned char)(std::max(life, 0.0f) * 255.0f) };
+            this->ParticleColors->SetTypedTuple(i, rgba);
+        }
+        this->ParticleColors->Modified();
+        this->ParticleData->Modified();
+    }
+
+    unsigned int FrameCount() const { return this->Replay.FrameCount(); }
+    unsigned int CurrentFrame() const { return this->Frame; }
+
+private:
+    SnapshotReader Replay;
+    unsigned int Frame = 0;
+    double Elapsed = 0.0;
+    float LatticeSpacing = 0.0f;
+
+    vtkPolyData* GridData = nullptr;
+    vtkPolyData* ParticleData = nullptr;
+    vtkActor* SphereActor = nullptr;
+    std::vector<float> GridX, GridZ, GridFlat;
+    vtkSmartPointer<vtkSOADataArrayTemplate<float>> GridPoints = vtkSmartPointer<vtkSOADataArrayTemplate<float>>::New();
+    vtkSmartPointer<vtkSOADataArrayTemplate<float>> ParticlePoints = vtkSmartPointer<vtkSOADataArrayTemplate<float>>::New();
+    vtkSmartPointer<vtkCellArray> ParticleCells = vtkSmartPointer<vtkCellArray>::New();
+    vtkSmartPointer<vtkUnsignedCharArray> ParticleColors = vtkSmartPointer<vtkUnsignedCharArray>::New();
+};
+
+// --headless --replay PATH: shows every frame from --replay-frame on without a window
+static int runReplayHeadless(vtkReplayCallback* replayCallback, vtkPolyData* particleData)
+{
+    unsigned int first = replayCallback->CurrentFrame();
+    vtkIdType particleTotal = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int f = first; f < replayCallback->FrameCount(); ++f) {
+        replayCallback->ShowFrame(f);
+        particleTotal += particleData->GetNumberOfPoints();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    unsigned int frames = replayCallback->FrameCount() - first;
+
+    std::cout << "replay_frames: " << frames << "\n"
+              << "wall_seconds: " << seconds << "\n"
+              << "frames_per_second: " << (seconds > 0.0 ? frames / seconds : 0.0) << "\n"
+              << "ms_per_frame: " << (frames > 0 ? seconds * 1000.0 / frames : 0.0) << "\n"
+              << "particles_read: " << particleTotal << std::endl;
+    return EXIT_SUCCESS;
+}
+
+// --headless [--steps N]: ticks the grid N times with no window and prints a summary
+static int runHeadless(vtkTimerCallback* timerCallback, vtkPolyData* gridData, unsigned int steps)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int step = 0; step < steps; ++step)
+        timerCallback->Advance();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double bounds[6];
+    gridData->GetPoints()->ComputeBounds();
+    gridData->GetPoints()->GetBounds(bounds);
+
+    std::cout << "steps: " << steps << "\n"
+              << "wall_seconds: " << seconds << "\n"
+              << "steps_per_second: " << (seconds > 0.0 ? steps / seconds : 0.0) << "\n"
+              << "ms_per_step: " << (steps > 0 ? seconds * 1000.0 / steps : 0.0) << "\n"
+              << "grid_points: " << gridData->GetNumberOfPoints() << "\n"
+              << "bodies: " << timerCallback->Bodies.Count << "\n"
+              << "grid_min_height: " << bounds[2] << std::endl;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[])
+{
+    bool headless = false;
+    unsigned int headlessSteps = 3600;
+    std::string replayPath;
+    unsigned int replayFrame = 0;
+    std::string scenePath;
+    bool lodGrid = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--headless") headless = true;
+        else if (arg == "--steps" && i + 1 < argc) headlessSteps = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--replay" && i + 1 < argc) replayPath = argv[++i];
+        else if (arg == "--scene" && i + 1 < argc) scenePath = argv[++i];
+        else if (arg == "--grid-lod") lodGrid = true;
+        else if (arg == "--replay-frame" && i + 1 < argc) replayFrame = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+    }
+
     vtkSmartPointer<vtkNamedColors> colors = vtkSmartPointer<vtkNamedColors>::New();
 
     vtkSmartPointer<vtkSphereSource> sphereSource = vtkSmartPointer<vtkSphereSource>::New();
@@ -79,29 +394,73 @@ int main(int, char*[])
     sphereSource->SetThetaResolution(30);
     
     vtkSmartPointer<vtkPlaneSource> planeSource = vtkSmartPointer<vtkPlaneSource>::New();
-    planeSource->SetXResolution(100);
-    planeSource->SetYResolution(100);
-    planeSource->SetOrigin(-50, 0, -50);
-    planeSource->SetPoint1(50, 0, -50);
-    planeSource->SetPoint2(-50, 0, 50);
+    planeSource->SetXResolution(GRID_RESOLUTION);
+    planeSource->SetYResolution(GRID_RESOLUTION);
+    planeSource->SetOrigin(-GRID_EXTENT, 0, -GRID_EXTENT);
+    planeSource->SetPoint1(GRID_EXTENT, 0, -GRID_EXTENT);
+    planeSource->SetPoint2(-GRID_EXTENT, 0, GRID_EXTENT);
+    planeSource->SetOutputPointsPrecision(vtkAlgorithm::SINGLE_PRECISION);
     planeSource->Update();
 
-    vtkSmartPointer<vtkWarpScalar> warpScalar = vtkSmartPointer<vtkWarpScalar>::New();
-    warpScalar->SetInputData(planeSource->GetOutput());
-    warpScalar->SetScaleFactor(VISUAL_SCALE);
-    warpScalar->UseNormalOn();
-    warpScalar->SetNormal(0, 1, 0);
+    // detached copy of the plane; its points are deformed in place by the timer
+    vtkSmartPointer<vtkPolyData> gridData = vtkSmartPointer<vtkPolyData>::New();
+    gridData->DeepCopy(planeSource->GetOutput());
 
     vtkSmartPointer<vtkPolyDataMapper> sphereMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
     sphereMapper->SetInputConnection(sphereSource->GetOutputPort());
 
     vtkSmartPointer<vtkPolyDataMapper> gridMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
-    gridMapper->SetInputConnection(warpScalar->GetOutputPort());
+    gridMapper->SetInputData(gridData);
 
     vtkSmartPointer<vtkActor> sphereActor = vtkSmartPointer<vtkActor>::New();
     sphereActor->SetMapper(sphereMapper);
     sphereActor->GetProperty()->SetColor(colors->GetColor3d("Silver").GetData());
 
+    vtkSmartPointer<vtkTimerCallback> timerCallback = vtkSmartPointer<vtkTimerCallback>::New();
+    timerCallback->SphereActor = sphereActor;
+    timerCallback->GravitationalParameter = 400.0f;
+    timerCallback->SetGrid(gridData);
+    // replays carry heights for the uniform grid only
+    if (lodGrid && replayPath.empty())
+        timerCallback->UseAdaptiveGrid();
+    timerCallback->PlaceSphere();
+    if (!scenePath.empty() && !LoadScene(scenePath, timerCallback->Bodies))
+        return EXIT_FAILURE;
+    vtkSmartPointer<vtkPolyData> bodyData = vtkSmartPointer<vtkPolyData>::New();
+    timerCallback->SetBodyPoints(bodyData);
+
+    vtkSmartPointer<vtkReplayCallback> replayCallback;
+    vtkSmartPointer<vtkPolyData> particleData = vtkSmartPointer<vtkPolyData>::New();
+    if (!replayPath.empty()) {
+        replayCallback = vtkSmartPointer<vtkReplayCallback>::New();
+        if (!replayCallback->Open(replayPath, replayFrame))
+            return EXIT_FAILURE;
+        // recordings come from the OpenGL build, whose sphere has radius 1
+        sphereActor->SetScale(0.5);
+        replayCallback->SetScene(gridData, particleData, sphereActor);
+    }
+
+    if (headless)
+        return replayCallback ? runReplayHeadless(replayCallback, particleData)
+                              : runHeadless(timerCallback, gridData, headlessSteps);
+
+    vtkSmartPointer<vtkPolyDataMapper> particleMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+    particleMapper->SetInputData(particleData);
+    particleMapper->SetColorModeToDirectScalars();
+    particleMapper->SetScalarModeToUsePointData();
+
+    vtkSmartPointer<vtkActor> particleActor = vtkSmartPointer<vtkActor>::New();
+    particleActor->SetMapper(particleMapper);
+    particleActor->GetProperty()->SetPointSize(3.0f);
+
+    vtkSmartPointer<vtkPolyDataMapper> bodyMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+    bodyMapper->SetInputData(bodyData);
+
+    vtkSmartPointer<vtkActor> bodyActor = vtkSmartPointer<vtkActor>::New();
+    bodyActor->SetMapper(bodyMapper);
+    bodyActor->GetProperty()->SetPointSize(2.0f);
+    bodyActor->GetProperty()->SetColor(colors->GetColor3d("Wheat").GetData());
+
     vtkSmartPointer<vtkActor> gridActor = vtkSmartPointer<vtkActor>::New();
     gridActor->SetMapper(gridMapper);
     gridActor->GetProperty()->SetRepresentationToWireframe();
@@ -110,6 +469,10 @@ int main(int, char*[])
     vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
     renderer->AddActor(sphereActor);
     renderer->AddActor(gridActor);
+    if (replayCallback)
+        renderer->AddActor(particleActor);
+    else if (timerCallback->Bodies.Count > 1)
+        renderer->AddActor(bodyActor);
     renderer->SetBackground(colors->GetColor3d("DarkSlateBlue").GetData());
 
     vtkSmartPointer<vtkRenderWindow> renderWindow = vtkSmartPointer<vtkRenderWindow>::New();
@@ -121,15 +484,13 @@ int main(int, char*[])
     renderWindowInteractor->SetRenderWindow(renderWindow);
     renderWindowInteractor->Initialize();
 
-    vtkSmartPointer<vtkTimerCallback> timerCallback = vtkSmartPointer<vtkTimerCallback>::New();
-    timerCallback->SphereActor = sphereActor;
-    timerCallback->PlaneSource = planeSource;
-    timerCallback->WarpFilter = warpScalar;
-    timerCallback->GravitationalParameter = 400.0f;
-    
-    timerCallback->UpdateGridDeformation();
-
-    renderWindowInteractor->AddObserver(vtkCommand::TimerEvent, timerCallback);
+    if (replayCallback) {
+        replayCallback->ShowFrame(replayCallback->CurrentFrame());
+        renderWindowInteractor->AddObserver(vtkCommand::TimerEvent, replayCallback);
+    } else {
+        timerCallback->UpdateGridDeformation();
+        renderWindowInteractor->AddObserver(vtkCommand::TimerEvent, timerCallback);
+    }
     renderWindowInteractor->CreateRepeatingTimer(1000.0 / 60.0);
 
     renderWindowInteractor->Start();
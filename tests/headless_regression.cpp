@@ -0,0 +1,87 @@
+// tests/headless_regression.cpp
+// the --headless loop with a fixed seed, checked against pinned results: the cloud's
+// momentum early on, then how many particles are alive at the end and the life each
+// one has left. no window or GL context; exits non-zero on a mismatch
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <glm/glm.hpp>
+#include "BodyRegistry.h"
+#include "ParticleSystem.h"
+#include "Simulation.h"
+
+// 0.045 s does not divide the 8 s lifetime, so no particle is left at exactly
+// zero life: the first 23 steps' particles have died by the end, the rest live
+const unsigned int STEPS = 200;
+const float TIME_STEP = 0.045f;
+const uint32_t SEED = 7;
+const float PARTICLE_LIFETIME = 8.0f;
+
+const unsigned int EXPECTED_LIVE = 1770;
+const float LIFE_TOLERANCE = 1e-3f;
+// the cloud is chaotic: by step 50 the SIMD levels and FMA contraction have moved
+// its momentum by hundreds. at step 10 scalar, SSE, AVX2 and -march=haswell builds
+// still agree to 0.003, while a doubled pass or a lost kick is off by tens
+const unsigned int MOMENTUM_STEP = 10;
+const glm::vec3 EXPECTED_MOMENTUM(-40.978f, 61.207f, 169.226f);
+const float MOMENTUM_TOLERANCE = 0.05f;
+
+static int failures = 0;
+
+static void expect(bool ok, const char* what)
+{
+    if (!ok) {
+        std::printf("FALHOU: %s\n", what);
+        failures++;
+    }
+}
+
+static glm::vec3 cloudMomentum(const ParticleStore& ps)
+{
+    glm::vec3 momentum(0.0f);
+    for (unsigned int i = 0; i < ps.LiveCount; ++i)
+        momentum += ps.Mass[i] * ps.Velocity(i);
+    return momentum;
+}
+
+int main()
+{
+    CommandLineOptions options;
+    options.Steps = STEPS;
+    options.TimeStep = TIME_STEP;
+    options.Seed = SEED;
+
+    ParticleSystem particles(0, PARTICLE_POOL_SIZE, options.Threads);
+    configureParticles(particles, options);
+    BodyRegistry bodies;
+    BodyHandle sphere;
+    if (!setupBodies(bodies, sphere, options))
+        return 1;
+
+    const ParticleStore& ps = particles.Particles();
+    for (unsigned int step = 0; step < STEPS; ++step) {
+        stepScripted(particles, bodies, sphere, step, TIME_STEP);
+        if (step + 1 == MOMENTUM_STEP) {
+            glm::vec3 momentum = cloudMomentum(ps);
+            std::printf("momentum_at_%u: %.4f %.4f %.4f\n", MOMENTUM_STEP, momentum.x, momentum.y, momentum.z);
+            expect(glm::length(momentum - EXPECTED_MOMENTUM) <= MOMENTUM_TOLERANCE, "momentum");
+        }
+    }
+
+    std::printf("live_particles: %u\n", ps.LiveCount);
+    expect(ps.LiveCount == EXPECTED_LIVE, "live_particles");
+
+    // survivors stay in spawn order, PARTICLES_PER_STEP to a step, and age by
+    // exactly TIME_STEP per step from the step they were spawned in
+    const unsigned int firstStep = STEPS - EXPECTED_LIVE / PARTICLES_PER_STEP;
+    float worstLife = 0.0f;
+    for (unsigned int i = 0; i < ps.LiveCount; ++i) {
+        unsigned int spawned = firstStep + i / PARTICLES_PER_STEP;
+        float expected = PARTICLE_LIFETIME - (STEPS - spawned) * TIME_STEP;
+        worstLife = std::max(worstLife, std::fabs(ps.Life[i] - expected));
+    }
+    std::printf("worst_life_error: %g\n", worstLife);
+    expect(worstLife <= LIFE_TOLERANCE, "life");
+
+    return failures == 0 ? 0 : 1;
+}